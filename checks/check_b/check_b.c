@@ -3,10 +3,20 @@
  * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
  */
 
+#include <linux/atomic.h>
+#include <linux/cpumask.h>
+#include <linux/cred.h>
 #include <linux/init.h>
+#include <linux/log2.h>
 #include <linux/module.h>
+#include <linux/moduleparam.h>
 #include <linux/printk.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
 #include <linux/sched/signal.h>
+#include <linux/slab.h>
+#include <linux/threads.h>
+#include <linux/workqueue.h>
 
 #include "lkm_check.h"
 
@@ -23,27 +33,202 @@ static struct lkm_check check_b = {
     .run = check_b_enumeration,
 };
 
+#define CHECK_B_MAX_SHARDS 64
+
+/**
+ * Serial by default: the shards run on unbound kworkers, outside of what the
+ * core applies to its own runs (exec policy, CPUs and CPU budget).
+ */
+static unsigned int shards = 1;
+module_param(shards, uint, 0644);
+MODULE_PARM_DESC(shards, "Parallel walkers of the PID space. 1: serial walk (default), 0: one per online CPU");
+
+static bool verify;
+module_param(verify, bool, 0644);
+MODULE_PARM_DESC(verify, "Also walk the task list and compare it with the sharded walk");
+
+/**
+ * The PID space is cut into blocks that the shards claim one at a time, so a
+ * shard that finds a crowded block does not hold the others back. Empty blocks
+ * only cost one IDR lookup.
+ */
+#define CHECK_B_BLOCK_PIDS 4096
+#define CHECK_B_BLOCKS DIV_ROUND_UP(PID_MAX_LIMIT, CHECK_B_BLOCK_PIDS)
+
+//States as in /proc/<pid>/stat, see task_state_index()
+#define CHECK_B_NR_STATES (ilog2(TASK_REPORT_MAX) + 1)
+
+struct check_b_inventory{
+    unsigned long processes;
+    unsigned long threads;
+    unsigned long kthreads;
+    unsigned long root;
+    unsigned long state[CHECK_B_NR_STATES];
+};
+
+struct check_b_shard{
+    struct work_struct work;
+    struct seq_file *m;
+    atomic_t *next_block;
+    struct check_b_inventory inv;
+};
+
+/**
+ * Called under rcu_read_lock() by the core.
+ */
+static int check_b_account(struct task_struct *task, void *data){
+    struct check_b_inventory *inv = data;
+
+    inv->processes++;
+    inv->threads += get_nr_threads(task);
+    if(task->flags & PF_KTHREAD)
+        inv->kthreads++;
+    if(uid_eq(task_uid(task), GLOBAL_ROOT_UID))
+        inv->root++;
+    inv->state[task_state_index(task)]++;
+
+    return 0;
+}
+
+static void check_b_merge(struct check_b_inventory *dst, const struct check_b_inventory *src){
+    dst->processes += src->processes;
+    dst->threads += src->threads;
+    dst->kthreads += src->kthreads;
+    dst->root += src->root;
+    for(int i = 0; i < CHECK_B_NR_STATES; i++)
+        dst->state[i] += src->state[i];
+}
+
+static void check_b_shard_fn(struct work_struct *work){
+    struct check_b_shard *shard = container_of(work, struct check_b_shard, work);
+    int block;
+    int first;
+
+    while((block = atomic_inc_return(shard->next_block) - 1) < CHECK_B_BLOCKS){
+        first = block * CHECK_B_BLOCK_PIDS;
+        core_scope_for_each_process_range(shard->m, first, first + CHECK_B_BLOCK_PIDS,
+            check_b_account, &shard->inv);
+        cond_resched();
+    }
+}
+
+/**
+ * https://docs.kernel.org/core-api/workqueue.html
+ * Unbound work items run on the CPUs of the workqueue cpumask
+ * (/sys/devices/virtual/workqueue/cpumask), which leaves out isolcpus=domain
+ * CPUs but not nohz_full ones. They are plain kworkers: not SCHED_IDLE, not
+ * limited to the core's exec CPUs and not charged to its CPU budget, hence
+ * the serial default.
+ *
+ * Falls back to the serial walk when the shards cannot be allocated.
+ */
+static unsigned int check_b_walk_sharded(struct seq_file *m, struct check_b_inventory *inv){
+    struct check_b_shard *shard;
+    atomic_t next_block = ATOMIC_INIT(0);
+    unsigned int nr = READ_ONCE(shards);
+
+    if(!nr)
+        nr = num_online_cpus();
+    nr = min_t(unsigned int, nr, CHECK_B_MAX_SHARDS);
+
+    shard = nr > 1 ? kcalloc(nr, sizeof(*shard), GFP_KERNEL) : NULL;
+    if(!shard){
+        core_scope_for_each_process(m, check_b_account, inv);
+        return 1;
+    }
+
+    for(unsigned int i = 0; i < nr; i++){
+        INIT_WORK(&shard[i].work, check_b_shard_fn);
+        shard[i].m = m;
+        shard[i].next_block = &next_block;
+        queue_work(system_unbound_wq, &shard[i].work);
+    }
+
+    for(unsigned int i = 0; i < nr; i++){
+        flush_work(&shard[i].work);
+        check_b_merge(inv, &shard[i].inv);
+    }
+
+    kfree(shard);
+    return nr;
+}
+
+/**
+ * The reference is the task list, not the PID IDR: in a PID namespace scope
+ * core_scope_for_each_process() walks the IDR as well, so it would compare
+ * the walk with itself. Only sharded walks are verified: an unscoped serial
+ * walk is the task list itself.
+ *
+ * Task states change between any two walks, so only the counts are compared.
+ * Processes can come and go during the walks, so on a busy host a small
+ * difference is expected.
+ */
+static void check_b_verify(struct seq_file *m, const struct check_b_inventory *walked, unsigned int nr){
+    struct check_b_inventory ref = {};
+    struct task_struct *task;
+
+    if(nr <= 1){
+        seq_printf(m, "- Verify:skipped, only sharded walks are verified\n");
+        return;
+    }
+
+    rcu_read_lock();
+    for_each_process(task){
+        if(core_scope_task_in(m, task))
+            check_b_account(task, &ref);
+    }
+    rcu_read_unlock();
+
+    if(ref.processes == walked->processes && ref.threads == walked->threads &&
+        ref.kthreads == walked->kthreads && ref.root == walked->root){
+        seq_printf(m, "- Verify:ok\n");
+        return;
+    }
+
+    seq_printf(m, "- Verify:mismatch (task list/walk) processes %lu/%lu, threads %lu/%lu, "
+        "kernel threads %lu/%lu, root %lu/%lu\n",
+        ref.processes, walked->processes, ref.threads, walked->threads,
+        ref.kthreads, walked->kthreads, ref.root, walked->root);
+}
+
 /**
  * 
  * RCU locks usage and processes:
  * https://www.kernel.org/doc/Documentation/RCU/listRCU.rst
+ * The core walks the processes under rcu_read_lock(), only those in the scope of the run.
+ * A PID namespace scope walks only that namespace, a cgroup scope still walks
+ * every process and filters them, see core_scope_for_each_process().
  * 
  * https://docs.kernel.org/core-api/printk-formats.html
  */
 static int check_b_enumeration(struct seq_file *m){
     pr_info("Check B is saying hi!\n");
 
-    struct task_struct *task;
-    int count = 0;
+    struct check_b_inventory inv = {};
+    unsigned int nr;
 
-    rcu_read_lock();
-    for_each_process(task)
-        count++;
-    rcu_read_unlock();
+    nr = check_b_walk_sharded(m, &inv);
 
     seq_printf(m,
         "--- Check %s ---\n"
-        "- Total processes:%d\n", check_b.alias, count);
+        "- Scope:%s\n"
+        "- Total processes:%lu\n"
+        "- Threads:%lu\n"
+        "- Kernel threads:%lu\n"
+        "- User processes:%lu\n"
+        "- Owned by root:%lu\n", check_b.alias, core_scope_desc(m), inv.processes,
+        inv.threads, inv.kthreads, inv.processes - inv.kthreads, inv.root);
+
+    seq_printf(m, "- States:");
+    for(int i = 0; i < CHECK_B_NR_STATES; i++){
+        if(inv.state[i])
+            seq_printf(m, " %c=%lu", task_index_to_char(i), inv.state[i]);
+    }
+    seq_printf(m, "\n- Shards:%u\n", nr);
+
+    if(READ_ONCE(verify))
+        check_b_verify(m, &inv, nr);
+
     return 0;
 }
 
@@ -60,4 +245,4 @@ module_exit(check_exit);
 MODULE_LICENSE("GPL");
 MODULE_ALIAS("check_b");
 MODULE_AUTHOR("SAUL FERNANDEZ GARCIA");
-MODULE_DESCRIPTION("Sample check plugin for process enumeration");
\ No newline at end of file
+MODULE_DESCRIPTION("Process inventory check plugin, sharded over the PID space");
\ No newline at end of file
@@ -0,0 +1,414 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#include <crypto/hash.h>
+#include <linux/bitmap.h>
+#include <linux/init.h>
+#include <linux/kprobes.h>
+#include <linux/ktime.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/printk.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <asm/unistd.h>
+
+#include "lkm_check.h"
+
+static int check_integrity_run(struct seq_file *m);
+static int __init check_init(void);
+static void __exit check_exit(void);
+
+static struct lkm_check check_integrity = {
+    .abi_version = LKM_CHECK_ABI_VERSION,
+    .owner = THIS_MODULE,
+    .name = "check_integrity",
+    .alias = "check_integrity",
+    .category = "integrity",
+    .run = check_integrity_run,
+    //A run moves the cursor and the baseline: it must not be run again on overflow
+    .flags = LKM_CHECK_F_ONESHOT,
+};
+
+static char *alg = "sha256";
+module_param(alg, charp, 0444);
+MODULE_PARM_DESC(alg, "shash algorithm, e.g. sha256, crc32c, xxhash64 (default sha256)");
+
+static unsigned int chunk_pages = 1024;
+module_param(chunk_pages, uint, 0644);
+MODULE_PARM_DESC(chunk_pages, "Pages rehashed per run, round-robin. 0: everything every run. Unused while sampled");
+
+static bool rebaseline;
+module_param(rebaseline, bool, 0644);
+MODULE_PARM_DESC(rebaseline, "Set to 1 to take the next pass as the new baseline");
+
+#define INTEGRITY_MAX_REPORTED 64
+
+/**
+ * A range of kernel memory, hashed page by page. The digests of all regions
+ * share one array, a region starts at "first_page" in it.
+ */
+struct integrity_region{
+    const char *name;
+    unsigned long start;
+    unsigned long end;
+    unsigned int first_page;
+    unsigned int nr_pages;
+};
+
+enum integrity_region_id{
+    REGION_TEXT,
+    REGION_RODATA,
+    REGION_SYSCALLS,
+    REGION_MAX,
+};
+
+static struct integrity_region regions[REGION_MAX] = {
+    [REGION_TEXT] = { .name = "text" },
+    [REGION_RODATA] = { .name = "rodata" },
+    [REGION_SYSCALLS] = { .name = "sys_call_table" },
+};
+
+//Every field below is protected by lock_integrity: runs may overlap
+static DEFINE_MUTEX(lock_integrity);
+static struct crypto_shash *tfm;
+static unsigned int digest_size;
+static unsigned int total_pages;
+static u8 *baseline;                //total_pages * digest_size
+static unsigned long *have_baseline;
+static unsigned long *changed;
+static unsigned int cursor;
+static unsigned long passes;
+
+//--------------------------------------------------------------------------------
+//Symbols
+
+typedef unsigned long (*kallsyms_lookup_name_t)(const char *name);
+static kallsyms_lookup_name_t lookup_name;
+
+/**
+ * kallsyms_lookup_name() is no longer exported (5.7). A kprobe on it still
+ * resolves its address.
+ *
+ * https://docs.kernel.org/trace/kprobes.html
+ */
+static int integrity_resolve_lookup(void){
+#ifdef CONFIG_KPROBES
+    struct kprobe kp = {
+        .symbol_name = "kallsyms_lookup_name",
+    };
+    int ret;
+
+    ret = register_kprobe(&kp);
+    if(ret)
+        return ret;
+
+    lookup_name = (kallsyms_lookup_name_t)kp.addr;
+    unregister_kprobe(&kp);
+
+    return lookup_name ? 0 : -ENOENT;
+#else
+    return -EOPNOTSUPP;
+#endif
+}
+
+static void integrity_set_region(enum integrity_region_id id, unsigned long start, unsigned long end){
+    struct integrity_region *region = &regions[id];
+
+    if(!start || end <= start){
+        pr_warn("lkm: check_integrity: %s not found, skipped\n", region->name);
+        return;
+    }
+
+    region->start = start;
+    region->end = end;
+    region->first_page = total_pages;
+    region->nr_pages = DIV_ROUND_UP(end - start, PAGE_SIZE);
+    total_pages += region->nr_pages;
+}
+
+static void integrity_find_regions(void){
+    unsigned long table = lookup_name("sys_call_table");
+
+    integrity_set_region(REGION_TEXT, lookup_name("_stext"), lookup_name("_etext"));
+    integrity_set_region(REGION_RODATA, lookup_name("__start_rodata"), lookup_name("__end_rodata"));
+#ifdef NR_syscalls
+    integrity_set_region(REGION_SYSCALLS, table, table ? table + NR_syscalls * sizeof(void *) : 0);
+#else
+    integrity_set_region(REGION_SYSCALLS, 0, 0);
+#endif
+}
+
+//--------------------------------------------------------------------------------
+//Hashing
+
+static struct integrity_region *integrity_region_of(unsigned int page){
+    for(int i = 0; i < REGION_MAX; i++){
+        if(regions[i].nr_pages && page - regions[i].first_page < regions[i].nr_pages)
+            return &regions[i];
+    }
+    return NULL;
+}
+
+static unsigned long integrity_page_addr(struct integrity_region *region, unsigned int page){
+    return region->start + (unsigned long)(page - region->first_page) * PAGE_SIZE;
+}
+
+/**
+ * https://docs.kernel.org/crypto/api-digest.html
+ * The crypto API picks the highest priority driver for "alg", usually the
+ * SIMD one (sha256-avx2, crc32c-intel...).
+ */
+static int integrity_hash_page(struct shash_desc *desc, unsigned int page, u8 *out, size_t *len){
+    struct integrity_region *region = integrity_region_of(page);
+    unsigned long addr = integrity_page_addr(region, page);
+
+    *len = min_t(unsigned long, PAGE_SIZE, region->end - addr);
+    return crypto_shash_digest(desc, (const u8 *)addr, *len, out);
+}
+
+/**
+ * Compares one page with its baseline, or takes it as the baseline.
+ * Returns true if the page differs.
+ */
+static bool integrity_check_page(unsigned int page, const u8 *digest){
+    u8 *base = baseline + (size_t)page * digest_size;
+
+    if(!test_bit(page, have_baseline)){
+        memcpy(base, digest, digest_size);
+        set_bit(page, have_baseline);
+        return false;
+    }
+
+    if(memcmp(base, digest, digest_size) == 0){
+        clear_bit(page, changed);
+        return false;
+    }
+
+    set_bit(page, changed);
+    return true;
+}
+
+//--------------------------------------------------------------------------------
+//Report
+
+/**
+ * Syscall table entries are expected to point into kernel text. Anything else
+ * usually means a hooked table.
+ */
+static void integrity_show_syscalls(struct seq_file *m){
+    struct integrity_region *table = &regions[REGION_SYSCALLS];
+    struct integrity_region *text = &regions[REGION_TEXT];
+    const unsigned long *entry;
+    unsigned long nr;
+    unsigned long outside = 0;
+
+    if(!table->nr_pages || !text->nr_pages)
+        return;
+
+    nr = (table->end - table->start) / sizeof(*entry);
+    entry = (const unsigned long *)table->start;
+
+    for(unsigned long i = 0; i < nr; i++){
+        if(entry[i] >= text->start && entry[i] < text->end)
+            continue;
+
+        if(outside++ < INTEGRITY_MAX_REPORTED)
+            seq_printf(m, "- syscall %lu points outside text: %pS\n", i, (void *)entry[i]);
+    }
+
+    seq_printf(m, "- Syscall entries outside text:%lu/%lu\n", outside, nr);
+}
+
+/**
+ * Text changes are not always an attack: ftrace, kprobes, static keys and
+ * livepatches patch text at runtime.
+ */
+static void integrity_show_changed(struct seq_file *m){
+    struct integrity_region *region;
+    unsigned int page;
+    unsigned int count = 0;
+
+    for_each_set_bit(page, changed, total_pages){
+        region = integrity_region_of(page);
+        if(count++ < INTEGRITY_MAX_REPORTED)
+            seq_printf(m, "- changed %s page %u: %pS\n", region->name,
+                page - region->first_page, (void *)integrity_page_addr(region, page));
+    }
+
+    seq_printf(m, "- Changed pages:%u\n", count);
+}
+
+//--------------------------------------------------------------------------------
+//Run
+
+static int integrity_hash_one(struct seq_file *m, struct shash_desc *desc, unsigned int page,
+    unsigned int *differ, size_t *bytes){
+    u8 digest[HASH_MAX_DIGESTSIZE];
+    size_t len;
+    int ret;
+
+    ret = integrity_hash_page(desc, page, digest, &len);
+    if(ret)
+        return ret;
+
+    if(integrity_check_page(page, digest))
+        (*differ)++;
+    *bytes += len;
+
+    core_run_yield(m);
+    return 0;
+}
+
+/**
+ * Each run rehashes "chunk_pages" pages from where the previous one stopped,
+ * so the cost of a run is bounded and a full pass spreads over several runs.
+ * The first pass builds the baseline.
+ *
+ * When the core samples the check, the pages of the run are picked by the
+ * core instead: 1 in "rate" pages spread over all the regions, a full pass
+ * every "rate" runs.
+ */
+static int check_integrity_run(struct seq_file *m){
+    SHASH_DESC_ON_STACK(desc, tfm);
+    bool sampled = core_sample_rate(m) > 1;
+    unsigned int todo;
+    unsigned int hashed = 0;
+    unsigned int differ = 0;
+    u64 start;
+    u64 elapsed;
+    size_t bytes = 0;
+    int ret = 0;
+
+    mutex_lock(&lock_integrity);
+
+    if(READ_ONCE(rebaseline)){
+        bitmap_zero(have_baseline, total_pages);
+        bitmap_zero(changed, total_pages);
+        cursor = 0;
+        WRITE_ONCE(rebaseline, false);
+    }
+
+    todo = READ_ONCE(chunk_pages);
+    if(!todo || todo > total_pages)
+        todo = total_pages;
+
+    desc->tfm = tfm;
+    start = ktime_get_ns();
+
+    if(sampled){
+        for(unsigned int page = 0; page < total_pages && !ret; page++){
+            if(!core_sample_take(m, page))
+                continue;
+
+            ret = integrity_hash_one(m, desc, page, &differ, &bytes);
+            if(!ret)
+                hashed++;
+        }
+    }else{
+        for(; hashed < todo; hashed++){
+            ret = integrity_hash_one(m, desc, cursor, &differ, &bytes);
+            if(ret)
+                break;
+
+            if(++cursor == total_pages){
+                cursor = 0;
+                passes++;
+            }
+        }
+    }
+
+    elapsed = ktime_get_ns() - start;
+    shash_desc_zero(desc);
+
+    seq_printf(m, "--- Check %s ---\n", check_integrity.alias);
+    seq_printf(m, "- Algorithm:%s (%s)\n", crypto_shash_alg_name(tfm), crypto_shash_driver_name(tfm));
+    for(int i = 0; i < REGION_MAX; i++){
+        if(regions[i].nr_pages)
+            seq_printf(m, "- Region %s:%lu bytes, %u pages\n", regions[i].name,
+                regions[i].end - regions[i].start, regions[i].nr_pages);
+    }
+
+    if(ret)
+        seq_printf(m, "- Hashing failed: %d\n", ret);
+
+    seq_printf(m, "- Hashed:%u pages, %zu bytes in %llu us (%llu MB/s)\n", hashed, bytes,
+        elapsed / NSEC_PER_USEC, elapsed ? (u64)bytes * NSEC_PER_SEC / elapsed / SZ_1M : 0);
+    if(sampled)
+        seq_printf(m, "- Baseline:%u/%u pages, sampled 1/%u\n",
+            bitmap_weight(have_baseline, total_pages), total_pages, core_sample_rate(m));
+    else
+        seq_printf(m, "- Baseline:%u/%u pages, pass %lu, next page %u\n",
+            bitmap_weight(have_baseline, total_pages), total_pages, passes, cursor);
+    seq_printf(m, "- Differing in this run:%u\n", differ);
+
+    integrity_show_changed(m);
+    integrity_show_syscalls(m);
+
+    mutex_unlock(&lock_integrity);
+    return ret;
+}
+
+//--------------------------------------------------------------------------------
+
+static int __init check_init(void){
+    int ret;
+
+    ret = integrity_resolve_lookup();
+    if(ret){
+        pr_err("lkm: check_integrity: cannot resolve kallsyms_lookup_name (%d)\n", ret);
+        return ret;
+    }
+
+    integrity_find_regions();
+    if(!total_pages)
+        return -ENOENT;
+
+    tfm = crypto_alloc_shash(alg, 0, 0);
+    if(IS_ERR(tfm)){
+        pr_err("lkm: check_integrity: no shash \"%s\" (%ld)\n", alg, PTR_ERR(tfm));
+        return PTR_ERR(tfm);
+    }
+    digest_size = crypto_shash_digestsize(tfm);
+
+    ret = -ENOMEM;
+    baseline = kvcalloc(total_pages, digest_size, GFP_KERNEL_ACCOUNT);
+    have_baseline = bitmap_zalloc(total_pages, GFP_KERNEL_ACCOUNT);
+    changed = bitmap_zalloc(total_pages, GFP_KERNEL_ACCOUNT);
+    if(!baseline || !have_baseline || !changed)
+        goto err_free;
+
+    ret = core_register_check(&check_integrity);
+    if(ret)
+        goto err_free;
+
+    return 0;
+
+err_free:
+    bitmap_free(changed);
+    bitmap_free(have_baseline);
+    kvfree(baseline);
+    crypto_free_shash(tfm);
+    return ret;
+}
+module_init(check_init);
+
+static void __exit check_exit(void){
+    core_unregister_check(&check_integrity);
+
+    bitmap_free(changed);
+    bitmap_free(have_baseline);
+    kvfree(baseline);
+    crypto_free_shash(tfm);
+}
+module_exit(check_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_ALIAS("check_integrity");
+MODULE_AUTHOR("SAUL FERNANDEZ GARCIA");
+MODULE_DESCRIPTION("Integrity of kernel text, rodata and the syscall table");
@@ -6,8 +6,13 @@
  */
 
 
+#include <linux/build_bug.h>
 #include <linux/debugfs.h>
+#include <linux/hashtable.h>
+#include <linux/idr.h>
 #include <linux/init.h>
+#include <linux/jhash.h>
+#include <linux/kref.h>
 #include <linux/list.h>
 #include <linux/module.h>
 #include <linux/kernel.h>
@@ -23,13 +28,36 @@
 static LIST_HEAD(list_available);
 static DEFINE_MUTEX(lock_list_available);
 
-static LIST_HEAD(list_selected);
-static DEFINE_MUTEX(lock_list_selected);
+/**
+ * Lookups of available checks, under lock_list_available. The list keeps
+ * the registration order for walks and display.
+ */
+#define CHECK_HASH_BITS 10
+static DEFINE_HASHTABLE(checks_by_alias, CHECK_HASH_BITS);
+static DEFINE_HASHTABLE(checks_by_name, CHECK_HASH_BITS);
+static DEFINE_HASHTABLE(checks_by_id, CHECK_HASH_BITS);
+
+//The "selected" list of debugfs. Each chardev fd has its own selection.
+static struct core_selection selected = {
+    .entries = LIST_HEAD_INIT(selected.entries),
+    .lock = __MUTEX_INITIALIZER(selected.lock),
+    .node = LIST_HEAD_INIT(selected.node),
+};
+
+//Every other selection, so unregistration can reach them
+static LIST_HEAD(list_selections);
+static DEFINE_MUTEX(lock_list_selections);
 
 
 struct entry_available{
     struct list_head list;
+    struct hlist_node alias_node;   //checks_by_alias, keyed by alias_hash
+    struct hlist_node name_node;    //checks_by_name, keyed by name_hash
+    struct hlist_node id_node;      //checks_by_id
     struct lkm_check *check;
+    const void *registered;         //What the plugin passed: a v1 check if != check
+    struct core_check_state *state;
+    struct dentry *results_file;    //results.d/<alias>
 };
 
 
@@ -38,6 +66,320 @@ struct entry_selected{
     struct lkm_check *check;
 };
 
+//Entries come from their own accounted caches, see core_entries_init()
+static struct kmem_cache *cache_available;
+static struct kmem_cache *cache_selected;
+
+//IDs of the registered checks
+static DEFINE_IDA(check_ids);
+
+//The hot part of struct lkm_check must fit in its first cache line
+static_assert(offsetof(struct lkm_check, flags) + sizeof(u32) <= L1_CACHE_BYTES);
+static_assert(offsetof(struct lkm_check, abi_version) == offsetof(struct lkm_check_v1, abi_version));
+
+//--------------------------------------------------------------------------------
+//Lookup
+
+static u32 check_hash(const char *str){
+    return jhash(str, strlen(str), 0);
+}
+
+/**
+ * @hash: check_hash(@name), computed once per lookup. Strings are only
+ * compared when a hash matches.
+ */
+static bool check_matches(const struct lkm_check *check, const char *name, u32 hash){
+    if(check->alias_hash == hash && strcmp(check->alias, name) == 0)
+        return true;
+    if(check->name_hash == hash && strcmp(check->name, name) == 0)
+        return true;
+    return false;
+}
+
+/**
+ * Available check by alias or name, aliases first. Called with
+ * lock_list_available held.
+ */
+static struct entry_available *entry_find(const char *name){
+    struct entry_available *pos;
+    u32 hash = check_hash(name);
+
+    hash_for_each_possible(checks_by_alias, pos, alias_node, hash){
+        if(pos->check->alias_hash == hash && strcmp(pos->check->alias, name) == 0)
+            return pos;
+    }
+
+    hash_for_each_possible(checks_by_name, pos, name_node, hash){
+        if(pos->check->name_hash == hash && strcmp(pos->check->name, name) == 0)
+            return pos;
+    }
+
+    return NULL;
+}
+
+static struct entry_available *entry_find_id(u32 id){
+    struct entry_available *pos;
+
+    hash_for_each_possible(checks_by_id, pos, id_node, id){
+        if(pos->check->id == id)
+            return pos;
+    }
+
+    return NULL;
+}
+
+/**
+ * Entry of @check, NULL if it is not registered. @check must still be
+ * readable: pinned, or its results.d file being opened.
+ */
+static struct entry_available *entry_find_check(struct lkm_check *check){
+    struct entry_available *entry = entry_find_id(check->id);
+
+    return entry && entry->check == check ? entry : NULL;
+}
+
+static void entry_hash(struct entry_available *entry){
+    hash_add(checks_by_alias, &entry->alias_node, entry->check->alias_hash);
+    hash_add(checks_by_name, &entry->name_node, entry->check->name_hash);
+    hash_add(checks_by_id, &entry->id_node, entry->check->id);
+}
+
+static void entry_unhash(struct entry_available *entry){
+    hash_del(&entry->alias_node);
+    hash_del(&entry->name_node);
+    hash_del(&entry->id_node);
+}
+
+//--------------------------------------------------------------------------------
+//Entry allocation
+
+static struct entry_selected *entry_selected_alloc(void){
+    struct entry_selected *sel;
+
+    sel = kmem_cache_zalloc(cache_selected, GFP_KERNEL_ACCOUNT);
+    if(sel)
+        core_mem_add(CORE_MEM_ENTRIES, sizeof(*sel));
+
+    return sel;
+}
+
+static void entry_selected_free(struct entry_selected *sel){
+    core_mem_add(CORE_MEM_ENTRIES, -(long)sizeof(*sel));
+    kmem_cache_free(cache_selected, sel);
+}
+
+/**
+ * The state of a check lives apart from its entry: output buffers kept after a
+ * run (triggered runs, fd results) may outlive the registration.
+ */
+static struct entry_available *entry_available_alloc(void){
+    struct entry_available *entry;
+
+    entry = kmem_cache_zalloc(cache_available, GFP_KERNEL_ACCOUNT);
+    if(!entry)
+        return NULL;
+
+    entry->state = kzalloc(sizeof(*entry->state), GFP_KERNEL_ACCOUNT);
+    if(!entry->state){
+        kmem_cache_free(cache_available, entry);
+        return NULL;
+    }
+
+    kref_init(&entry->state->ref);
+    mutex_init(&entry->state->cache_lock);
+    mutex_init(&entry->state->delta_lock);
+    mutex_init(&entry->state->sample_lock);
+    core_mem_add(CORE_MEM_ENTRIES, sizeof(*entry) + sizeof(*entry->state));
+
+    return entry;
+}
+
+static void entry_available_free(struct entry_available *entry){
+    core_mem_add(CORE_MEM_ENTRIES, -(long)sizeof(*entry));
+    core_check_state_put(entry->state);
+    kmem_cache_free(cache_available, entry);
+}
+
+static void check_state_release(struct kref *ref){
+    struct core_check_state *state = container_of(ref, struct core_check_state, ref);
+
+    core_mem_add(CORE_MEM_ENTRIES, -(long)sizeof(*state));
+    kfree(state);
+}
+
+void core_check_state_put(struct core_check_state *state){
+    kref_put(&state->ref, check_state_release);
+}
+
+/**
+ * Returns a reference on the state of @check, or NULL if it is not registered.
+ */
+struct core_check_state *core_check_state_get(struct lkm_check *check){
+    struct entry_available *entry;
+    struct core_check_state *state = NULL;
+
+    mutex_lock(&lock_list_available);
+    entry = entry_find_check(check);
+    if(entry){
+        state = entry->state;
+        kref_get(&state->ref);
+    }
+    mutex_unlock(&lock_list_available);
+
+    return state;
+}
+
+/**
+ * @name: alias or name of an available check.
+ * @bytes: maximum output of one run. 0 goes back to "output_budget".
+ */
+int core_check_set_budget(const char *name, size_t bytes){
+    struct entry_available *entry;
+    int ret = -ENOENT;
+
+    if(bytes && bytes < CORE_BUDGET_MIN)
+        return -EINVAL;
+
+    mutex_lock(&lock_list_available);
+    entry = entry_find(name);
+    if(entry){
+        WRITE_ONCE(entry->state->out_budget, bytes);
+        ret = 0;
+    }
+    mutex_unlock(&lock_list_available);
+
+    return ret;
+}
+
+/**
+ * Per-check lines of the "memory" file.
+ */
+void core_show_check_memory(struct seq_file *m){
+    struct entry_available *pos;
+    struct core_check_state *state;
+
+    mutex_lock(&lock_list_available);
+    list_for_each_entry(pos, &list_available, list){
+        state = pos->state;
+        seq_printf(m, "%-24s %10zu %10ld %10ld %10d\n", pos->check->alias,
+            READ_ONCE(state->out_budget) ? : READ_ONCE(core_output_budget),
+            atomic_long_read(&state->mem_used), atomic_long_read(&state->mem_peak),
+            atomic_read(&state->truncated));
+    }
+    mutex_unlock(&lock_list_available);
+}
+
+/**
+ * @name: alias or name of an available check.
+ * @rate: the check's sampled walks take 1 in @rate items per run. 0 or 1: all.
+ * @seed: which items fall together in a run. Same seed, same runs.
+ *
+ * Restarts the rotation of every reader: the next @rate runs delivered to
+ * each of them cover every item.
+ */
+int core_check_set_sampling(const char *name, u32 rate, u32 seed){
+    struct entry_available *entry;
+    struct core_check_state *state;
+    int ret = -ENOENT;
+
+    mutex_lock(&lock_list_available);
+    entry = entry_find(name);
+    if(entry){
+        state = entry->state;
+        mutex_lock(&state->sample_lock);
+        state->sample_rate = rate;
+        state->sample_seed = seed;
+        state->sample_gen++;
+        memset(state->sample_cursors, 0, sizeof(state->sample_cursors));
+        mutex_unlock(&state->sample_lock);
+        ret = 0;
+    }
+    mutex_unlock(&lock_list_available);
+
+    return ret;
+}
+
+static const char * const core_reader_names[CORE_READER_MAX] = {
+    [CORE_READER_RESULTS] = "results",
+    [CORE_READER_SINGLE]  = "results.d",
+    [CORE_READER_DELTA]   = "delta",
+    [CORE_READER_TRIGGER] = "trigger",
+    [CORE_READER_BOOT]    = "boot",
+    [CORE_READER_IOCTL]   = "ioctl",
+};
+
+/**
+ * One line per sampled check, then where each reader is in its rotation:
+ * "<reader>:<next slot>/<slots delivered>".
+ */
+void core_show_sampling(struct seq_file *m){
+    struct entry_available *pos;
+    struct core_check_state *state;
+    struct core_sample_cursor *cursor;
+
+    seq_printf(m, "%-24s %10s %10s  %s\n", "check", "rate", "seed", "readers");
+
+    mutex_lock(&lock_list_available);
+    list_for_each_entry(pos, &list_available, list){
+        state = pos->state;
+
+        mutex_lock(&state->sample_lock);
+        if(state->sample_rate > 1){
+            seq_printf(m, "%-24s %10u %10u ", pos->check->alias, state->sample_rate, state->sample_seed);
+            for(int i = 0; i < CORE_READER_MAX; i++){
+                cursor = &state->sample_cursors[i];
+                seq_printf(m, " %s:%u/%u", core_reader_names[i], cursor->next, cursor->delivered);
+            }
+            seq_printf(m, "\n");
+        }
+        mutex_unlock(&state->sample_lock);
+    }
+    mutex_unlock(&lock_list_available);
+}
+
+/**
+ * One line per available check: "<id> <alias hash> <alias> <name> <category>".
+ */
+void core_show_index(struct seq_file *m){
+    struct entry_available *pos;
+    struct lkm_check *check;
+
+    mutex_lock(&lock_list_available);
+    list_for_each_entry(pos, &list_available, list){
+        check = pos->check;
+        seq_printf(m, "%u %08x %s %s %s%s\n", check->id, check->alias_hash,
+            check->alias, check->name, check->category[0] ? check->category : "-",
+            check == pos->registered ? "" : " (v1)");
+    }
+    mutex_unlock(&lock_list_available);
+}
+
+//--------------------------------------------------------------------------------
+//Pinning
+
+/**
+ * A pinned check cannot be unregistered under our feet. Plugins are pinned
+ * through their module; BPF checks belong to this module, so they are also
+ * pinned on their own, see core_bpf.c.
+ */
+static bool check_tryget(struct lkm_check *check){
+    if(!try_module_get(check->owner))
+        return false;
+
+    if(core_bpf_is_check(check) && !core_bpf_check_tryget(check)){
+        module_put(check->owner);
+        return false;
+    }
+
+    return true;
+}
+
+static void check_put(struct lkm_check *check){
+    if(core_bpf_is_check(check))
+        core_bpf_check_put(check);
+    module_put(check->owner);
+}
+
 //--------------------------------------------------------------------------------
 //List traversal
 
@@ -60,14 +402,15 @@ void core_for_each_available(
         return;
     }
 
-    snapshot = kcalloc(count, sizeof(*snapshot), GFP_KERNEL);
+    snapshot = kcalloc(count, sizeof(*snapshot), GFP_KERNEL_ACCOUNT);
     if(!snapshot){
         mutex_unlock(&lock_list_available);
         return;
     }
+    core_mem_add(CORE_MEM_SNAPSHOTS, count * sizeof(*snapshot));
 
     list_for_each_entry(pos, &list_available, list){
-        if(try_module_get(pos->check->owner)){
+        if(check_tryget(pos->check)){
             snapshot[i] = pos->check;
             i++;
         }
@@ -76,9 +419,10 @@ void core_for_each_available(
 
     for(int j = 0; j < i; j++){
         cb(snapshot[j], data);
-        module_put(snapshot[j]->owner);
+        check_put(snapshot[j]);
     }
 
+    core_mem_add(CORE_MEM_SNAPSHOTS, -(long)(count * sizeof(*snapshot)));
     kfree(snapshot);    
 }
 
@@ -88,7 +432,7 @@ void core_for_each_available(
  * kmalloc calloc array allocation: kcalloc
  * https://www.kernel.org/doc/html/v5.0/core-api/mm-api.html#c.kzalloc
  */
-void core_for_each_selected(
+void core_selection_for_each(struct core_selection *selection,
     void (*cb)(struct lkm_check *check, void *data),
     void*data){
     
@@ -98,63 +442,69 @@ void core_for_each_selected(
     int i = 0;
 
     //Count how many checks to run and allocate array
-    mutex_lock(&lock_list_selected);
-    list_for_each_entry(pos, &list_selected, list){
+    mutex_lock(&selection->lock);
+    list_for_each_entry(pos, &selection->entries, list){
         count++;
     }
     
 
     if(!count){
-        mutex_unlock(&lock_list_selected);
+        mutex_unlock(&selection->lock);
         return;
     }
 
-    snapshot = kcalloc(count, sizeof(*snapshot), GFP_KERNEL);
+    snapshot = kcalloc(count, sizeof(*snapshot), GFP_KERNEL_ACCOUNT);
     if(!snapshot){
-        mutex_unlock(&lock_list_selected);
+        mutex_unlock(&selection->lock);
         return;
     }
+    core_mem_add(CORE_MEM_SNAPSHOTS, count * sizeof(*snapshot));
 
     //Add checks to snapshot + pin them to avoid unregistration
-    list_for_each_entry(pos, &list_selected, list){
-        if(try_module_get(pos->check->owner)){
+    list_for_each_entry(pos, &selection->entries, list){
+        if(check_tryget(pos->check)){
             snapshot[i] = pos->check;
             i++;
         }
     }
-    mutex_unlock(&lock_list_selected);
+    mutex_unlock(&selection->lock);
 
     //Run the checks with no locked lists along the process
     for(int j = 0; j < i; j++){
         cb(snapshot[j], data);
-        module_put(snapshot[j]->owner);
+        check_put(snapshot[j]);
     }
 
+    core_mem_add(CORE_MEM_SNAPSHOTS, -(long)(count * sizeof(*snapshot)));
     kfree(snapshot);
 
 }
 
+void core_for_each_selected(
+    void (*cb)(struct lkm_check *check, void *data),
+    void*data){
+    core_selection_for_each(&selected, cb, data);
+}
+
 //--------------------------------------------------------------------------------
 //Entry selection
 
 /**
- * 
+ * @selection: where to add the check, "selected" or a chardev fd's own.
+ * @name: alias or name of an available check.
  */
-int core_select_check(const char *name){
+int core_selection_select(struct core_selection *selection, const char *name){
     
     int ret = 0;
     struct lkm_check *found = NULL;
-    struct entry_available *pos = NULL;
+    struct entry_available *entry = NULL;
     struct entry_selected *sel = NULL;
 
     //Check to see if the plugin is available
     mutex_lock(&lock_list_available);
-    list_for_each_entry(pos, &list_available, list){
-        if(strcmp(pos->check->alias, name) == 0 || strcmp(pos->check->name, name) == 0){
-            found = pos->check;
-            break;
-        }
-    }
+    entry = entry_find(name);
+    if(entry)
+        found = entry->check;
 
     //If found, actually store the data into our list of selected checks
     if(!found){
@@ -164,8 +514,8 @@ int core_select_check(const char *name){
     } 
 
     //__Check if plugin is already in list of selected
-    mutex_lock(&lock_list_selected);
-    list_for_each_entry(sel, &list_selected, list){
+    mutex_lock(&selection->lock);
+    list_for_each_entry(sel, &selection->entries, list){
         if(sel->check == found){
             ret = -EEXIST;
             goto out_unlock_selected;
@@ -173,31 +523,31 @@ int core_select_check(const char *name){
     }
 
     //__Take module reference for refcount
-    if(!try_module_get(found->owner)){
+    if(!check_tryget(found)){
         ret = -EINVAL;
         goto out_unlock_selected;
     }
     
     //Allocate new entry_selected for list_selected
-    sel = kzalloc(sizeof(*sel), GFP_KERNEL);
+    sel = entry_selected_alloc();
     if(!sel){
         ret = -ENOMEM;
-        goto out_module_put;
+        goto out_put_check;
     }
     
     pr_info("lkm: plugin %s was not in selected list. It will now be added.\n", found->alias);
     sel->check = found;
-    list_add_tail(&sel->list, &list_selected);
+    list_add_tail(&sel->list, &selection->entries);
     ret = 0;
     pr_info("lkm: added to 'selected' the check with alias: %s\n", found->alias);
 
     goto out_unlock_selected; //equivalent to performing unlock(selected) and unlock(available) and then return 0;
 
-out_module_put:
-    module_put(found->owner);
+out_put_check:
+    check_put(found);
 
 out_unlock_selected:
-    mutex_unlock(&lock_list_selected);
+    mutex_unlock(&selection->lock);
 
 out_unlock_available:
     mutex_unlock(&lock_list_available);
@@ -206,11 +556,15 @@ out_unlock_available:
     return ret;
 }
 
+int core_select_check(const char *name){
+    return core_selection_select(&selected, name);
+}
+
 /**
  * 
  * Best-effort approach, returns last error if any.
  */
-int core_addall(void){
+int core_selection_addall(struct core_selection *selection){
 
     struct entry_available *pos = NULL;
     struct entry_selected *sel = NULL;
@@ -218,12 +572,12 @@ int core_addall(void){
     int last_ret = 0;
 
     mutex_lock(&lock_list_available);
-    mutex_lock(&lock_list_selected);
+    mutex_lock(&selection->lock);
 
     list_for_each_entry(pos, &list_available, list){
 
         int already = 0;
-        list_for_each_entry(sel, &list_selected, list){
+        list_for_each_entry(sel, &selection->entries, list){
             if(sel->check == pos->check){
                 already = 1;
                 break;
@@ -233,50 +587,55 @@ int core_addall(void){
         if(already)
             continue;
 
-        if(!try_module_get(pos->check->owner)){
+        if(!check_tryget(pos->check)){
             last_ret = -EINVAL;
             continue;
         }
 
-        new_sel = kzalloc(sizeof(*new_sel), GFP_KERNEL);
+        new_sel = entry_selected_alloc();
         if(!new_sel){
-            module_put(pos->check->owner);
+            check_put(pos->check);
             last_ret = -ENOMEM;
             continue;
         }
 
         new_sel->check = pos->check;
-        list_add_tail(&new_sel->list, &list_selected);
+        list_add_tail(&new_sel->list, &selection->entries);
         pr_info("lkm: added to 'selected' the check with alias: %s\n", new_sel->check->alias);
     }
 
-    mutex_unlock(&lock_list_selected);
+    mutex_unlock(&selection->lock);
     mutex_unlock(&lock_list_available);
 
     return last_ret;
 }
 
+int core_addall(void){
+    return core_selection_addall(&selected);
+}
+
 /**
  * 
  * list_for_each_entry_safe()
  */
-int core_remove_check(const char*name){
+int core_selection_remove(struct core_selection *selection, const char*name){
     struct entry_selected *pos;
     struct entry_selected *temp;
+    u32 hash = check_hash(name);
     int found = 0;
 
-    mutex_lock(&lock_list_selected);
-    list_for_each_entry_safe(pos, temp, &list_selected, list){
-        if(strcmp(pos->check->alias, name) == 0 || strcmp(pos->check->name, name) == 0){
+    mutex_lock(&selection->lock);
+    list_for_each_entry_safe(pos, temp, &selection->entries, list){
+        if(check_matches(pos->check, name, hash)){
             list_del(&pos->list);
             pr_info("lkm: removed from 'selected' the check with alias: %s\n", pos->check->alias);
-            module_put(pos->check->owner);
-            kfree(pos);
+            check_put(pos->check);
+            entry_selected_free(pos);
             found = 1;
             break;
         }
     }
-    mutex_unlock(&lock_list_selected);
+    mutex_unlock(&selection->lock);
 
     if(!found)
         return -ENOENT;
@@ -284,97 +643,324 @@ int core_remove_check(const char*name){
     return 0;
 }
 
-void core_empty_selected(void){
+int core_remove_check(const char *name){
+    return core_selection_remove(&selected, name);
+}
+
+void core_selection_empty(struct core_selection *selection){
     struct entry_selected *pos;
     struct entry_selected *temp;
 
-    mutex_lock(&lock_list_selected);
-    list_for_each_entry_safe(pos, temp, &list_selected, list){
+    mutex_lock(&selection->lock);
+    list_for_each_entry_safe(pos, temp, &selection->entries, list){
         list_del(&pos->list);
-        module_put(pos->check->owner);
-        kfree(pos);
+        check_put(pos->check);
+        entry_selected_free(pos);
     }
-    mutex_unlock(&lock_list_selected);
+    mutex_unlock(&selection->lock);
+}
+
+void core_empty_selected(void){
+    core_selection_empty(&selected);
+}
+
+/**
+ * Per-fd selections of the chardev are tracked so that unregistration
+ * can drop the check from them too.
+ */
+void core_selection_init(struct core_selection *selection){
+    INIT_LIST_HEAD(&selection->entries);
+    mutex_init(&selection->lock);
+
+    mutex_lock(&lock_list_selections);
+    list_add_tail(&selection->node, &list_selections);
+    mutex_unlock(&lock_list_selections);
+}
+
+void core_selection_destroy(struct core_selection *selection){
+    mutex_lock(&lock_list_selections);
+    list_del_init(&selection->node);
+    mutex_unlock(&lock_list_selections);
+
+    core_selection_empty(selection);
+    mutex_destroy(&selection->lock);
+}
+
+/**
+ * Looks up an available check by alias/name and pins its module.
+ * Returns NULL if there is no such check or it is going away.
+ */
+struct lkm_check *core_get_check(const char *name){
+    struct entry_available *entry;
+    struct lkm_check *found = NULL;
+
+    mutex_lock(&lock_list_available);
+    entry = entry_find(name);
+    if(entry && check_tryget(entry->check))
+        found = entry->check;
+    mutex_unlock(&lock_list_available);
+
+    return found;
+}
+
+/**
+ * Same as core_get_check(), by the ID shown in "index".
+ */
+struct lkm_check *core_get_check_id(u32 id){
+    struct entry_available *entry;
+    struct lkm_check *found = NULL;
+
+    mutex_lock(&lock_list_available);
+    entry = entry_find_id(id);
+    if(entry && check_tryget(entry->check))
+        found = entry->check;
+    mutex_unlock(&lock_list_available);
+
+    return found;
+}
+
+/**
+ * Same as core_get_check() when the caller already has the pointer, e.g. from
+ * the i_private of a results.d file. Returns false if it is not registered.
+ */
+bool core_pin_check(struct lkm_check *check){
+    bool pinned = false;
+
+    mutex_lock(&lock_list_available);
+    if(entry_find_check(check))
+        pinned = check_tryget(check);
+    mutex_unlock(&lock_list_available);
+
+    return pinned;
+}
+
+void core_put_check(struct lkm_check *check){
+    check_put(check);
 }
 
 //--------------------------------------------------------------------------------
 
 
+static bool check_string_ok(const char *str, size_t size){
+    size_t len = strnlen(str, size);
+
+    return len && len < size;
+}
+
+/**
+ * Rejects what would break the lists and debugfs later on.
+ */
+static int check_validate(const struct lkm_check *check){
+    if(!check->run)
+        return -EINVAL;
+    if(check->flags & ~LKM_CHECK_F_ALL)
+        return -EINVAL;
+    if(!check_string_ok(check->name, PLUGIN_MAX_NAME) || !check_string_ok(check->alias, PLUGIN_MAX_ALIAS))
+        return -EINVAL;
+    if(strnlen(check->category, PLUGIN_MAX_CATEGORY) == PLUGIN_MAX_CATEGORY)
+        return -EINVAL;
+
+    return 0;
+}
+
+/**
+ * Builds the v2 copy of a v1 check. An empty alias falls back to the name,
+ * as v1 never required one.
+ */
+static struct lkm_check *check_from_v1(const struct lkm_check_v1 *old){
+    struct lkm_check *check;
+
+    if(!check_string_ok(old->name, PLUGIN_MAX_NAME))
+        return ERR_PTR(-EINVAL);
+
+    check = kzalloc(sizeof(*check), GFP_KERNEL_ACCOUNT);
+    if(!check)
+        return ERR_PTR(-ENOMEM);
+    core_mem_add(CORE_MEM_ENTRIES, sizeof(*check));
+
+    check->abi_version = LKM_CHECK_ABI_V2;
+    check->run = old->run;
+    check->owner = old->owner;
+    strscpy((char *)check->name, old->name, PLUGIN_MAX_NAME);
+    strscpy((char *)check->category, old->category, PLUGIN_MAX_CATEGORY);
+    strscpy((char *)check->alias, old->alias[0] ? old->alias : old->name, PLUGIN_MAX_ALIAS);
+
+    return check;
+}
+
+static void check_v1_free(struct lkm_check *check){
+    core_mem_add(CORE_MEM_ENTRIES, -(long)sizeof(*check));
+    kfree(check);
+}
+
 /**
  * Registration API Definition
  * @check: plugin check to register.
  * 
  * Registration is in queue fashion (list_add_tail).
+ * The ID and hashes are set here, before the check is visible.
  */
 int core_register_check(struct lkm_check *check){
     
     int ret = 0;
     struct entry_available *new_entry = NULL;
+    const void *registered = check;
+    int id;
+
+    switch(check->abi_version){
+    case LKM_CHECK_ABI_V1:
+        check = check_from_v1(registered);
+        if(IS_ERR(check)){
+            pr_err("lkm: v1 check rejected (%ld)\n", PTR_ERR(check));
+            return PTR_ERR(check);
+        }
+        break;
+    case LKM_CHECK_ABI_V2:
+        break;
+    default:
+        pr_err("lkm: check with unknown ABI version %d rejected\n", check->abi_version);
+        return -EINVAL;
+    }
+
+    ret = check_validate(check);
+    if(ret){
+        pr_err("lkm: malformed check rejected\n");
+        goto err_free;
+    }
+
+    id = ida_alloc_min(&check_ids, 1, GFP_KERNEL);
+    if(id < 0){
+        ret = id;
+        goto err_free;
+    }
+
+    check->id = id;
+    check->name_hash = check_hash(check->name);
+    check->alias_hash = check_hash(check->alias);
 
     pr_info("lkm: check %s requesting registration\n", check->name);
     mutex_lock(&lock_list_available);
     pr_info("lkm: check %s began registration\n", check->name);
 
-    new_entry = kzalloc(sizeof(*new_entry), GFP_KERNEL);
+    new_entry = entry_available_alloc();
     if(!new_entry){
         ret = -ENOMEM;
         goto out_unlock_available;
     }
 
     new_entry->check = check;
+    new_entry->registered = registered;
+    new_entry->results_file = core_debugfs_add_check(check);
     list_add_tail(&new_entry->list, &list_available);
-    pr_info("lkm: check %s finished registration\n", check->name);
+    entry_hash(new_entry);
+    pr_info("lkm: check %s finished registration (id %u)\n", check->name, check->id);
 
 out_unlock_available:
     mutex_unlock(&lock_list_available);
 
+    if(!ret){
+        core_boot_check_registered(check);
+        return 0;
+    }
+
+    ida_free(&check_ids, check->id);
+err_free:
+    if(check != registered)
+        check_v1_free(check);
     return ret;
 }
 EXPORT_SYMBOL_GPL(core_register_check);
 
+static void selection_drop_check(struct core_selection *selection, struct lkm_check *check){
+    struct entry_selected *pos_s;
+    struct entry_selected *temp_s;
+
+    mutex_lock(&selection->lock);
+    list_for_each_entry_safe(pos_s, temp_s, &selection->entries, list){
+        if(pos_s->check == check){
+            list_del(&pos_s->list);
+            check_put(pos_s->check);
+            entry_selected_free(pos_s);
+            break;
+        }
+    }
+    mutex_unlock(&selection->lock);
+}
+
 /**
  * Unregistration API Definition
- * @check: plugin check to unregister.
+ * @check: plugin check to unregister, the same pointer that was registered.
  * 
  * Unregistration.
  * We first remove the plugin from the "selected" array to be able
+ *
+ * Called from the plugin's exit, when it cannot be pinned anymore: nothing
+ * still runs the v2 copy of a v1 check when it is freed here.
  */
 void core_unregister_check(struct lkm_check *check){
-    pr_info("lkm: check %s requesting unregistration\n", check->name);
+    struct core_selection *selection;
+    struct core_check_state *state = NULL;
+    struct dentry *results_file = NULL;
+    struct entry_available *entry = NULL;
+    struct entry_available *pos;
+    const void *registered = check;
 
     mutex_lock(&lock_list_available);
-    mutex_lock(&lock_list_selected);
 
-    //Removing plugin from "list_selected":
-    struct entry_selected *pos_s;
-    struct entry_selected *temp_s;
-    
-    list_for_each_entry_safe(pos_s, temp_s, &list_selected, list){
-        if(pos_s->check == check){
-            list_del(&pos_s->list);
-            module_put(pos_s->check->owner);
-            kfree(pos_s);
-            break;
+    //abi_version is first in every version. A v1 check has no ID: the core
+    //registered a copy of it, found through "registered"
+    if(check->abi_version == LKM_CHECK_ABI_V2){
+        entry = entry_find_check(check);
+    }else{
+        list_for_each_entry(pos, &list_available, list){
+            if(pos->registered == registered){
+                entry = pos;
+                break;
+            }
         }
     }
+    if(!entry){
+        mutex_unlock(&lock_list_available);
+        pr_warn("lkm: unregistration of a check that is not registered\n");
+        return;
+    }
+    check = entry->check;
 
-    //Removing plugin from "available" list
-    struct entry_available *pos_a;
-    struct entry_available *temp_a;
+    pr_info("lkm: check %s requesting unregistration\n", check->name);
+
+    //Removing plugin from "list_selected" and from the chardev selections:
+    selection_drop_check(&selected, check);
+
+    mutex_lock(&lock_list_selections);
+    list_for_each_entry(selection, &list_selections, node)
+        selection_drop_check(selection, check);
+    mutex_unlock(&lock_list_selections);
 
+    //Removing plugin from "available" list
     pr_info("lkm: check %s began unregistration\n", check->name);
 
-    list_for_each_entry_safe(pos_a, temp_a, &list_available, list){
-        if(pos_a->check == check){
-            list_del(&pos_a->list);
-            kfree(pos_a);
-            break;
-        }
-    }
+    list_del(&entry->list);
+    entry_unhash(entry);
+    results_file = entry->results_file;
+    state = entry->state;
+    kref_get(&state->ref);
+    entry_available_free(entry);
+
     pr_info("lkm: check %s finished unregistration\n", check->name);
 
-    mutex_unlock(&lock_list_selected);
     mutex_unlock(&lock_list_available);
+
+    //Waits for readers of the file, which take lock_list_available
+    core_debugfs_remove_check(results_file);
+
+    //The cached run holds a reference on the state. Its lock nests outside
+    //lock_list_available, so it is dropped here.
+    core_check_state_flush(state);
+    core_check_state_put(state);
+
+    ida_free(&check_ids, check->id);
+    if(check != registered)
+        check_v1_free(check);
 }
 EXPORT_SYMBOL_GPL(core_unregister_check);
 
@@ -382,6 +968,31 @@ EXPORT_SYMBOL_GPL(core_unregister_check);
 //--------------------------------------------------------------------------------
 
 
+/**
+ * https://docs.kernel.org/core-api/mm-api.html#c.kmem_cache_create
+ *
+ * SLAB_ACCOUNT charges the entries to the memcg of whoever selects/registers.
+ */
+static int __init core_entries_init(void){
+    cache_available = KMEM_CACHE(entry_available, SLAB_ACCOUNT);
+    if(!cache_available)
+        return -ENOMEM;
+
+    cache_selected = KMEM_CACHE(entry_selected, SLAB_ACCOUNT);
+    if(!cache_selected){
+        kmem_cache_destroy(cache_available);
+        return -ENOMEM;
+    }
+
+    return 0;
+}
+
+static void core_entries_exit(void){
+    ida_destroy(&check_ids);
+    kmem_cache_destroy(cache_selected);
+    kmem_cache_destroy(cache_available);
+}
+
 /**
  * __init
  * 
@@ -390,8 +1001,47 @@ EXPORT_SYMBOL_GPL(core_unregister_check);
  * Debugfs files will be at /sys/kernel/debug/lkmsfg/
  */
 static int __init core_init(void){
+    int ret;
+
     pr_info("lkm CORE: loading into kernel\n");
-    return core_debugfs_init();
+
+    ret = core_entries_init();
+    if(ret)
+        return ret;
+
+    ret = core_exec_init();
+    if(ret)
+        goto err_entries;
+
+    ret = core_trigger_init();
+    if(ret)
+        goto err_exec;
+
+    ret = core_debugfs_init();
+    if(ret)
+        goto err_trigger;
+
+    ret = core_chrdev_init();
+    if(ret)
+        goto err_debugfs;
+
+    //Last: BPF checks can register as soon as this returns. Without them
+    //(e.g. a module built without BTF) the core still works
+    ret = core_bpf_init();
+    if(ret)
+        pr_warn("lkm CORE: BPF checks disabled (%d)\n", ret);
+
+    return 0;
+
+err_debugfs:
+    core_debugfs_exit();
+err_trigger:
+    core_trigger_exit();
+err_exec:
+    core_exec_exit();
+err_entries:
+    core_entries_exit();
+    return ret;
 }
 module_init(core_init);
 
@@ -404,36 +1054,57 @@ module_init(core_init);
 static void __exit core_exit(void){
     pr_info("lkm CORE: removing from kernel\n");
 
+    //No fd can be open here: each one holds a reference on this module
+    core_chrdev_exit();
+
+    //Stop triggered runs before tearing down the lists they walk
+    core_trigger_exit();
+    core_boot_exit();
+
     //Free list_selected
     struct entry_selected *pos_s;
     struct entry_selected *temp_s;
     
-    mutex_lock(&lock_list_selected);
-    list_for_each_entry_safe(pos_s, temp_s, &list_selected, list){
+    mutex_lock(&selected.lock);
+    list_for_each_entry_safe(pos_s, temp_s, &selected.entries, list){
         pr_info("-Deleting plugin from list of selected: %s\n", pos_s->check->alias);
         list_del(&pos_s->list);
-        module_put(pos_s->check->owner);
-        kfree(pos_s);
+        check_put(pos_s->check);
+        entry_selected_free(pos_s);
     }
-    mutex_unlock(&lock_list_selected);
+    mutex_unlock(&selected.lock);
 
     //Free list_available
     struct entry_available *pos_a;
     struct entry_available *temp_a;
+    LIST_HEAD(dying);
 
     mutex_lock(&lock_list_available);
+    list_for_each_entry(pos_a, &list_available, list)
+        entry_unhash(pos_a);
+    list_splice_init(&list_available, &dying);
+    mutex_unlock(&lock_list_available);
 
-    list_for_each_entry_safe(pos_a, temp_a, &list_available, list){
+    list_for_each_entry_safe(pos_a, temp_a, &dying, list){
         pr_info("-Deleting plugin from available ones: %s\n", pos_a->check->alias);
         list_del(&pos_a->list);
-        kfree(pos_a);
+        core_check_state_flush(pos_a->state);
+        ida_free(&check_ids, pos_a->check->id);
+        if(pos_a->check != pos_a->registered)
+            check_v1_free(pos_a->check);
+        entry_available_free(pos_a);
     }
 
-    mutex_unlock(&lock_list_available);
-
     //Remove debugfs:
     core_debugfs_exit();
 
+    //Nothing can submit runs anymore
+    core_exec_exit();
+
+    core_scope_exit();
+
+    core_entries_exit();
+
     pr_info("lkm CORE: removed from kernel\n");
 }
 module_exit(core_exit);
@@ -0,0 +1,233 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * LKM: boot-time preselection and early scan
+ *
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/timekeeping.h>
+#include <linux/workqueue.h>
+
+#include "core_internal.h"
+
+
+/**
+ * Also on the kernel command line when built in, e.g.
+ * sfgcore.preselect=check_b,category:integrity sfgcore.boot_scan=1
+ */
+static char *preselect;
+module_param(preselect, charp, 0444);
+MODULE_PARM_DESC(preselect, "Checks selected as they register: aliases/names, \"category:<name>\" or \"*\", comma separated");
+
+static bool boot_scan;
+module_param(boot_scan, bool, 0444);
+MODULE_PARM_DESC(boot_scan, "Run preselected checks once as they register, results in \"boot_results\"");
+
+static unsigned int boot_scan_delay_ms = 500;
+module_param(boot_scan_delay_ms, uint, 0644);
+MODULE_PARM_DESC(boot_scan_delay_ms, "Wait after the last registration so checks loaded together share one scan (default 500)");
+
+/**
+ * The last boot scan run of a check, one per alias: a check registering again
+ * replaces its run. Kept until the core goes away.
+ */
+struct boot_item{
+    struct list_head list;
+    char alias[PLUGIN_MAX_ALIAS];
+    u64 stamp_ms;               //Since boot
+    int ret;
+    struct core_capture cap;
+};
+
+//Checks registered since the last scan
+struct boot_pending{
+    struct list_head list;
+    char alias[PLUGIN_MAX_ALIAS];
+};
+
+static LIST_HEAD(boot_pending);
+static LIST_HEAD(boot_items);
+static DEFINE_MUTEX(lock_boot);
+
+static void boot_scan_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(boot_work, boot_scan_fn);
+
+//--------------------------------------------------------------------------------
+//Preselection
+
+static bool boot_str_eq(const char *str, const char *tok, size_t len){
+    return strlen(str) == len && memcmp(str, tok, len) == 0;
+}
+
+static bool boot_token_matches(struct lkm_check *check, const char *tok, size_t len){
+    if(len == 1 && *tok == '*')
+        return true;
+
+    if(len > 9 && strncmp(tok, "category:", 9) == 0)
+        return boot_str_eq(check->category, tok + 9, len - 9);
+
+    return boot_str_eq(check->alias, tok, len) || boot_str_eq(check->name, tok, len);
+}
+
+static bool boot_matches(struct lkm_check *check){
+    const char *tok = preselect;
+    const char *end;
+
+    while(tok && *tok){
+        end = strchrnul(tok, ',');
+        if(end > tok && boot_token_matches(check, tok, end - tok))
+            return true;
+        tok = *end ? end + 1 : NULL;
+    }
+
+    return false;
+}
+
+/**
+ * Called once @check is registered, outside of the list locks.
+ */
+void core_boot_check_registered(struct lkm_check *check){
+    struct boot_pending *pending;
+    struct boot_pending *pos;
+    int ret;
+
+    if(!preselect || !boot_matches(check))
+        return;
+
+    ret = core_select_check(check->alias);
+    if(ret && ret != -EEXIST)
+        pr_warn("lkm: could not preselect %s (%d)\n", check->alias, ret);
+
+    if(!boot_scan)
+        return;
+
+    pending = kzalloc(sizeof(*pending), GFP_KERNEL);
+    if(!pending)
+        return;
+    strscpy(pending->alias, check->alias, sizeof(pending->alias));
+
+    mutex_lock(&lock_boot);
+    list_for_each_entry(pos, &boot_pending, list){
+        if(strcmp(pos->alias, pending->alias) == 0){
+            kfree(pending);
+            pending = NULL;
+            break;
+        }
+    }
+    if(pending)
+        list_add_tail(&pending->list, &boot_pending);
+    mutex_unlock(&lock_boot);
+
+    //Pushes the scan back if it is already pending
+    mod_delayed_work(system_unbound_wq, &boot_work, msecs_to_jiffies(READ_ONCE(boot_scan_delay_ms)));
+}
+
+//--------------------------------------------------------------------------------
+//Scan
+
+static void boot_item_free(struct boot_item *item){
+    core_capture_release(&item->cap);
+    kfree(item);
+}
+
+/**
+ * Adds @item, or replaces the run of the same check.
+ */
+static void boot_item_keep(struct boot_item *item){
+    struct boot_item *old = NULL;
+    struct boot_item *pos;
+
+    mutex_lock(&lock_boot);
+    list_for_each_entry(pos, &boot_items, list){
+        if(strcmp(pos->alias, item->alias) == 0){
+            old = pos;
+            break;
+        }
+    }
+
+    if(old)
+        list_replace(&old->list, &item->list);
+    else
+        list_add_tail(&item->list, &boot_items);
+    mutex_unlock(&lock_boot);
+
+    if(old)
+        boot_item_free(old);
+}
+
+/**
+ * Checks that went away in the meantime are skipped.
+ */
+static void boot_scan_fn(struct work_struct *work){
+    struct boot_pending *pending;
+    struct boot_pending *temp;
+    struct boot_item *item;
+    struct lkm_check *check;
+    LIST_HEAD(todo);
+
+    mutex_lock(&lock_boot);
+    list_splice_init(&boot_pending, &todo);
+    mutex_unlock(&lock_boot);
+
+    list_for_each_entry_safe(pending, temp, &todo, list){
+        list_del(&pending->list);
+
+        check = core_get_check(pending->alias);
+        item = check ? kzalloc(sizeof(*item), GFP_KERNEL_ACCOUNT) : NULL;
+        if(item){
+            strscpy(item->alias, check->alias, sizeof(item->alias));
+            item->ret = core_capture_check(check, &item->cap, CORE_READER_BOOT);
+            if(!item->ret)
+                core_capture_delivered(&item->cap);
+            item->stamp_ms = div_u64(ktime_get_boottime_ns(), NSEC_PER_MSEC);
+            boot_item_keep(item);
+        }
+
+        if(check)
+            core_put_check(check);
+        kfree(pending);
+    }
+}
+
+
+void core_boot_show_results(struct seq_file *m){
+    struct boot_item *item;
+
+    mutex_lock(&lock_boot);
+    list_for_each_entry(item, &boot_items, list){
+        seq_printf(m, "==== %s (%llu ms after boot) ====\n", item->alias, item->stamp_ms);
+        core_capture_show(m, &item->cap, item->ret);
+    }
+    mutex_unlock(&lock_boot);
+}
+
+//--------------------------------------------------------------------------------
+
+/**
+ * Called before the lists are torn down: the scan pins checks through them.
+ */
+void core_boot_exit(void){
+    struct boot_pending *pending;
+    struct boot_pending *temp;
+    struct boot_item *item;
+    struct boot_item *item_temp;
+
+    cancel_delayed_work_sync(&boot_work);
+
+    list_for_each_entry_safe(pending, temp, &boot_pending, list){
+        list_del(&pending->list);
+        kfree(pending);
+    }
+
+    list_for_each_entry_safe(item, item_temp, &boot_items, list){
+        list_del(&item->list);
+        boot_item_free(item);
+    }
+}
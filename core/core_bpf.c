@@ -0,0 +1,351 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * LKM: BPF-programmable checks (struct_ops + kfuncs)
+ *
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#include <linux/bpf.h>
+#include <linux/bpf_verifier.h>
+#include <linux/btf.h>
+#include <linux/btf_ids.h>
+#include <linux/completion.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/refcount.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "core_internal.h"
+
+#ifdef CORE_BPF
+
+/**
+ * A BPF check. Loaded as a struct_ops map, e.g. with libbpf:
+ *
+ *     SEC("struct_ops/run")
+ *     int BPF_PROG(my_run, struct lkm_bpf_run *run)
+ *     {
+ *         lkm_bpf_emit(run, "hello\n", 6);
+ *         return 0;
+ *     }
+ *
+ *     SEC(".struct_ops.link")
+ *     struct lkm_check_ops my_check = {
+ *         .run = (void *)my_run,
+ *         .name = "my_check",
+ *         .alias = "my_check",
+ *         .category = "bpf",
+ *     };
+ *
+ * Same fields as struct lkm_check, minus what the core fills in.
+ */
+struct lkm_check_ops{
+    int (*run)(struct lkm_bpf_run *run);
+    char name[PLUGIN_MAX_NAME];
+    char category[PLUGIN_MAX_CATEGORY];
+    char alias[PLUGIN_MAX_ALIAS];
+};
+
+/**
+ * Handed to the BPF program. Opaque, only used through the kfuncs.
+ */
+struct lkm_bpf_run{
+    struct seq_file *m;
+};
+
+/**
+ * The lkm_check registered on behalf of a struct_ops map.
+ *
+ * Native checks are pinned through their module. BPF checks are owned by the
+ * core, so they are pinned through "users" as well: unregistration waits for
+ * the last user before freeing them.
+ */
+struct lkm_bpf_check{
+    struct list_head list;
+    struct lkm_check check;
+    struct lkm_check_ops *ops;
+    refcount_t users;
+    struct completion released;
+};
+
+static LIST_HEAD(list_bpf_checks);
+static DEFINE_MUTEX(lock_list_bpf_checks);
+
+//--------------------------------------------------------------------------------
+//Kfuncs
+
+__bpf_kfunc_start_defs();
+
+/**
+ * Appends @data to the output of the run.
+ */
+__bpf_kfunc int lkm_bpf_emit(struct lkm_bpf_run *run, const void *data, u32 data__sz){
+    seq_write(run->m, data, data__sz);
+    return seq_has_overflowed(run->m) ? -EOVERFLOW : 0;
+}
+
+/**
+ * Appends a "<label>: <value>" line, the usual shape of a check finding.
+ */
+__bpf_kfunc int lkm_bpf_emit_u64(struct lkm_bpf_run *run, const char *label__str, u64 value){
+    seq_printf(run->m, "%s: %llu\n", label__str, value);
+    return seq_has_overflowed(run->m) ? -EOVERFLOW : 0;
+}
+
+/**
+ * Whether the run looks at the item @key, see core_sample_take().
+ */
+__bpf_kfunc bool lkm_bpf_sample_take(struct lkm_bpf_run *run, u64 key){
+    return core_sample_take(run->m, key);
+}
+
+__bpf_kfunc_end_defs();
+
+BTF_KFUNCS_START(lkm_bpf_kfunc_ids)
+BTF_ID_FLAGS(func, lkm_bpf_emit)
+BTF_ID_FLAGS(func, lkm_bpf_emit_u64)
+BTF_ID_FLAGS(func, lkm_bpf_sample_take)
+BTF_KFUNCS_END(lkm_bpf_kfunc_ids)
+
+static const struct btf_kfunc_id_set lkm_bpf_kfunc_set = {
+    .owner = THIS_MODULE,
+    .set = &lkm_bpf_kfunc_ids,
+};
+
+//--------------------------------------------------------------------------------
+//Core side
+
+static struct lkm_bpf_check *to_bpf_check(struct lkm_check *check){
+    return container_of(check, struct lkm_bpf_check, check);
+}
+
+/**
+ * run() of every BPF check. The core passes the check in m->private.
+ */
+static int lkm_bpf_run_check(struct seq_file *m){
+    struct core_run_ctx *ctx = m->private;
+    struct lkm_bpf_run run = {
+        .m = m,
+    };
+
+    return to_bpf_check(ctx->check)->ops->run(&run);
+}
+
+bool core_bpf_is_check(struct lkm_check *check){
+    return check->run == lkm_bpf_run_check;
+}
+
+bool core_bpf_check_tryget(struct lkm_check *check){
+    return refcount_inc_not_zero(&to_bpf_check(check)->users);
+}
+
+void core_bpf_check_put(struct lkm_check *check){
+    struct lkm_bpf_check *bcheck = to_bpf_check(check);
+
+    if(refcount_dec_and_test(&bcheck->users))
+        complete(&bcheck->released);
+}
+
+//--------------------------------------------------------------------------------
+//struct_ops
+
+static int lkm_bpf_init(struct btf *btf){
+    return 0;
+}
+
+static const struct bpf_func_proto *lkm_bpf_get_func_proto(enum bpf_func_id func_id, const struct bpf_prog *prog){
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 10, 0)
+    return bpf_base_func_proto(func_id, prog);
+#else
+    return bpf_base_func_proto(func_id);
+#endif
+}
+
+static bool lkm_bpf_is_valid_access(int off, int size, enum bpf_access_type type,
+    const struct bpf_prog *prog, struct bpf_insn_access_aux *info){
+    return bpf_tracing_btf_ctx_access(off, size, type, prog, info);
+}
+
+static const struct bpf_verifier_ops lkm_bpf_verifier_ops = {
+    .get_func_proto = lkm_bpf_get_func_proto,
+    .is_valid_access = lkm_bpf_is_valid_access,
+};
+
+static int lkm_bpf_copy_string(char *dst, const char *src, size_t size, bool required){
+    size_t len = strnlen(src, size);
+
+    if(len == size)
+        return -E2BIG;
+    if(required && !len)
+        return -EINVAL;
+
+    memcpy(dst, src, len + 1);
+    return 1;
+}
+
+/**
+ * Copies the non-function members from the map value (@udata) to the kernel
+ * copy (@kdata). Returning 1 tells BPF the member was handled here.
+ */
+static int lkm_bpf_init_member(const struct btf_type *t, const struct btf_member *member,
+    void *kdata, const void *udata){
+    const struct lkm_check_ops *uops = udata;
+    struct lkm_check_ops *ops = kdata;
+    u32 moff = __btf_member_bit_offset(t, member) / 8;
+
+    switch(moff){
+    case offsetof(struct lkm_check_ops, name):
+        return lkm_bpf_copy_string(ops->name, uops->name, sizeof(ops->name), true);
+    case offsetof(struct lkm_check_ops, category):
+        return lkm_bpf_copy_string(ops->category, uops->category, sizeof(ops->category), false);
+    case offsetof(struct lkm_check_ops, alias):
+        return lkm_bpf_copy_string(ops->alias, uops->alias, sizeof(ops->alias), false);
+    }
+
+    return 0;
+}
+
+static int lkm_bpf_check_member(const struct btf_type *t, const struct btf_member *member,
+    const struct bpf_prog *prog){
+    if(__btf_member_bit_offset(t, member) / 8 != offsetof(struct lkm_check_ops, run))
+        return -ENOTSUPP;
+
+    return 0;
+}
+
+/**
+ * Called when the map is attached: register it as any other check.
+ */
+static int lkm_bpf_reg(void *kdata){
+    struct lkm_check_ops *ops = kdata;
+    struct lkm_bpf_check *bcheck;
+    int ret;
+
+    if(!ops->run)
+        return -EINVAL;
+
+    bcheck = kzalloc(sizeof(*bcheck), GFP_KERNEL_ACCOUNT);
+    if(!bcheck)
+        return -ENOMEM;
+
+    bcheck->ops = ops;
+    refcount_set(&bcheck->users, 1);
+    init_completion(&bcheck->released);
+
+    bcheck->check.abi_version = LKM_CHECK_ABI_VERSION;
+    bcheck->check.owner = THIS_MODULE;
+    bcheck->check.run = lkm_bpf_run_check;
+    strscpy((char *)bcheck->check.name, ops->name, PLUGIN_MAX_NAME);
+    strscpy((char *)bcheck->check.alias, ops->alias[0] ? ops->alias : ops->name, PLUGIN_MAX_ALIAS);
+    strscpy((char *)bcheck->check.category, ops->category[0] ? ops->category : "bpf", PLUGIN_MAX_CATEGORY);
+
+    ret = core_register_check(&bcheck->check);
+    if(ret){
+        kfree(bcheck);
+        return ret;
+    }
+
+    mutex_lock(&lock_list_bpf_checks);
+    list_add_tail(&bcheck->list, &list_bpf_checks);
+    mutex_unlock(&lock_list_bpf_checks);
+
+    pr_info("lkm: BPF check %s attached\n", bcheck->check.alias);
+    return 0;
+}
+
+/**
+ * Called when the map is detached. The programs must stay callable until the
+ * last run is over, hence the wait.
+ */
+static void lkm_bpf_unreg(void *kdata){
+    struct lkm_bpf_check *bcheck = NULL;
+    struct lkm_bpf_check *pos;
+
+    mutex_lock(&lock_list_bpf_checks);
+    list_for_each_entry(pos, &list_bpf_checks, list){
+        if(pos->ops == kdata){
+            bcheck = pos;
+            list_del(&bcheck->list);
+            break;
+        }
+    }
+    mutex_unlock(&lock_list_bpf_checks);
+
+    if(!bcheck)
+        return;
+
+    core_unregister_check(&bcheck->check);
+    core_bpf_check_put(&bcheck->check);
+    wait_for_completion(&bcheck->released);
+
+    pr_info("lkm: BPF check %s detached\n", bcheck->check.alias);
+    kfree(bcheck);
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 10, 0)
+static int lkm_bpf_reg_link(void *kdata, struct bpf_link *link){
+    return lkm_bpf_reg(kdata);
+}
+
+static void lkm_bpf_unreg_link(void *kdata, struct bpf_link *link){
+    lkm_bpf_unreg(kdata);
+}
+#else
+#define lkm_bpf_reg_link lkm_bpf_reg
+#define lkm_bpf_unreg_link lkm_bpf_unreg
+#endif
+
+//CFI stubs: prototypes BPF checks the programs against
+static int lkm_check_ops__run(struct lkm_bpf_run *run){
+    return 0;
+}
+
+static struct lkm_check_ops __bpf_lkm_check_ops = {
+    .run = lkm_check_ops__run,
+};
+
+static struct bpf_struct_ops bpf_lkm_check_ops = {
+    .verifier_ops = &lkm_bpf_verifier_ops,
+    .init = lkm_bpf_init,
+    .check_member = lkm_bpf_check_member,
+    .init_member = lkm_bpf_init_member,
+    .reg = lkm_bpf_reg_link,
+    .unreg = lkm_bpf_unreg_link,
+    .cfi_stubs = &__bpf_lkm_check_ops,
+    .name = "lkm_check_ops",
+    .owner = THIS_MODULE,
+};
+
+//--------------------------------------------------------------------------------
+
+/**
+ * https://docs.kernel.org/bpf/kfuncs.html
+ * https://docs.kernel.org/bpf/libbpf/program_types.html (struct_ops)
+ *
+ * Both need the BTF of this module. CONFIG_DEBUG_INFO_BTF_MODULES does not
+ * guarantee it: an out-of-tree build against a tree without vmlinux skips it
+ * and this fails with -ENOENT. The caller carries on without BPF checks.
+ */
+int core_bpf_init(void){
+    int ret;
+
+    ret = register_btf_kfunc_id_set(BPF_PROG_TYPE_STRUCT_OPS, &lkm_bpf_kfunc_set);
+    if(ret){
+        pr_warn("lkm CORE: could not register BPF kfuncs (%d)\n", ret);
+        return ret;
+    }
+
+    ret = register_bpf_struct_ops(&bpf_lkm_check_ops, lkm_check_ops);
+    if(ret){
+        pr_warn("lkm CORE: could not register lkm_check_ops (%d)\n", ret);
+        return ret;
+    }
+
+    pr_info("lkm CORE: BPF checks enabled\n");
+    return 0;
+}
+
+#endif
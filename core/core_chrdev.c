@@ -0,0 +1,426 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * LKM: character device control plane
+ *
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+
+#include "core_internal.h"
+#include "lkm_ioctl.h"
+
+
+/**
+ * Per-fd context. Unlike debugfs, each agent works on its own selection and
+ * keeps the results of its last run.
+ */
+struct chrdev_ctx{
+    struct core_selection selection;
+    struct core_scope *scope;       //NULL: whole host
+
+    struct mutex lock;      //Serializes runs and fetches on this fd
+    char *results;
+    size_t results_len;
+    size_t results_size;
+};
+
+//--------------------------------------------------------------------------------
+//Results context
+
+static int ctx_append(struct chrdev_ctx *ctx, const char *data, size_t len){
+    size_t size = ctx->results_size ? ctx->results_size : PAGE_SIZE;
+    char *buf;
+
+    if(ctx->results_len + len <= ctx->results_size){
+        memcpy(ctx->results + ctx->results_len, data, len);
+        ctx->results_len += len;
+        return 0;
+    }
+
+    while(size < ctx->results_len + len)
+        size <<= 1;
+
+    buf = kvmalloc(size, GFP_KERNEL_ACCOUNT);
+    if(!buf)
+        return -ENOMEM;
+    core_mem_add(CORE_MEM_OUTPUT, size - ctx->results_size);
+
+    if(ctx->results_len)
+        memcpy(buf, ctx->results, ctx->results_len);
+    kvfree(ctx->results);
+
+    ctx->results = buf;
+    ctx->results_size = size;
+
+    memcpy(ctx->results + ctx->results_len, data, len);
+    ctx->results_len += len;
+    return 0;
+}
+
+/**
+ * Section of a check that could not be run. Returns @err.
+ */
+static int ctx_run_failed(struct chrdev_ctx *ctx, const char *name, int err){
+    char line[LKMSFG_NAME_MAX + 48];
+    int len;
+
+    len = scnprintf(line, sizeof(line), "==== %s ====\n# run failed: %d\n\n", name, err);
+    ctx_append(ctx, line, len);
+    return err;
+}
+
+/**
+ * Same layout and markers as the debugfs "results" file. Returns errors of
+ * the core only, what the check returned goes into the output.
+ */
+static int ctx_run_check(struct chrdev_ctx *ctx, struct lkm_check *check){
+    struct core_capture cap;
+    char line[PLUGIN_MAX_ALIAS + 32];
+    int len;
+    int ret;
+
+    ret = core_capture_check_scoped(check, &cap, ctx->scope, CORE_READER_IOCTL);
+    if(ret)
+        return ctx_run_failed(ctx, check->alias, ret);
+
+    len = scnprintf(line, sizeof(line), "==== %s ====\n", check->alias);
+    ret = ctx_append(ctx, line, len);
+    if(ret){
+        core_capture_release(&cap);
+        return ret;
+    }
+
+    ret = ctx_append(ctx, cap.buf, cap.len);
+    if(!ret)
+        core_capture_delivered(&cap);
+    if(!ret && cap.ret){
+        len = scnprintf(line, sizeof(line), "# run returned %d\n", cap.ret);
+        ret = ctx_append(ctx, line, len);
+    }
+    core_capture_release(&cap);
+
+    if(!ret)
+        ret = ctx_append(ctx, "\n", 1);
+    return ret;
+}
+
+struct ctx_run{
+    struct chrdev_ctx *ctx;
+    int ret;
+};
+
+//The selection is walked to the end, the first error is kept
+static void ctx_run_cb(struct lkm_check *check, void *data){
+    struct ctx_run *run = data;
+    int ret;
+
+    ret = ctx_run_check(run->ctx, check);
+    if(ret && !run->ret)
+        run->ret = ret;
+}
+
+static int ctx_copy_results(struct chrdev_ctx *ctx, u64 ubuf, u64 ubuf_len, u64 *out_len){
+    *out_len = ctx->results_len;
+
+    if(ubuf_len < ctx->results_len)
+        return -ENOSPC;
+    if(copy_to_user(u64_to_user_ptr(ubuf), ctx->results, ctx->results_len))
+        return -EFAULT;
+
+    return 0;
+}
+
+//--------------------------------------------------------------------------------
+//Ioctls
+
+static long chrdev_batch(struct chrdev_ctx *ctx, void __user *argp){
+    struct lkmsfg_batch batch;
+    struct lkmsfg_op __user *uops;
+    struct lkmsfg_op op;
+    u32 i;
+
+    if(copy_from_user(&batch, argp, sizeof(batch)))
+        return -EFAULT;
+    if(batch.count > LKMSFG_BATCH_MAX)
+        return -E2BIG;
+
+    uops = u64_to_user_ptr(batch.ops);
+    batch.failed = 0;
+
+    for(i = 0; i < batch.count; i++){
+        if(copy_from_user(&op, &uops[i], sizeof(op)))
+            return -EFAULT;
+        op.name[LKMSFG_NAME_MAX - 1] = '\0';
+
+        switch(op.code){
+        case LKMSFG_OP_SELECT:
+            op.result = core_selection_select(&ctx->selection, op.name);
+            break;
+        case LKMSFG_OP_REMOVE:
+            op.result = core_selection_remove(&ctx->selection, op.name);
+            break;
+        case LKMSFG_OP_EMPTY:
+            core_selection_empty(&ctx->selection);
+            op.result = 0;
+            break;
+        case LKMSFG_OP_ADDALL:
+            op.result = core_selection_addall(&ctx->selection);
+            break;
+        default:
+            op.result = -EINVAL;
+            break;
+        }
+
+        if(op.result < 0)
+            batch.failed++;
+
+        if(put_user(op.result, &uops[i].result))
+            return -EFAULT;
+    }
+
+    if(copy_to_user(argp, &batch, sizeof(batch)))
+        return -EFAULT;
+
+    return 0;
+}
+
+/**
+ * Reads the @i-th name or ID of @run and pins its check. @name is set to
+ * what is shown if there is no such check.
+ */
+static int chrdev_run_get(struct lkmsfg_run *run, u32 i, char *name, struct lkm_check **check){
+    u32 __user *uids = u64_to_user_ptr(run->names);
+    char __user *unames = u64_to_user_ptr(run->names);
+    u32 id;
+
+    if(run->flags & LKMSFG_RUN_IDS){
+        if(get_user(id, &uids[i]))
+            return -EFAULT;
+        snprintf(name, LKMSFG_NAME_MAX, "#%u", id);
+        *check = core_get_check_id(id);
+        return 0;
+    }
+
+    if(copy_from_user(name, unames + i * LKMSFG_NAME_MAX, LKMSFG_NAME_MAX))
+        return -EFAULT;
+    name[LKMSFG_NAME_MAX - 1] = '\0';
+    *check = core_get_check(name);
+    return 0;
+}
+
+static long chrdev_run(struct chrdev_ctx *ctx, void __user *argp){
+    struct lkmsfg_run run;
+    struct ctx_run state = {
+        .ctx = ctx,
+    };
+    char name[LKMSFG_NAME_MAX];
+    struct lkm_check *check;
+    long ret;
+    u32 i;
+
+    if(copy_from_user(&run, argp, sizeof(run)))
+        return -EFAULT;
+    if(run.flags & ~LKMSFG_RUN_IDS)
+        return -EINVAL;
+    if(run.count > LKMSFG_RUN_MAX)
+        return -E2BIG;
+
+    mutex_lock(&ctx->lock);
+    ctx->results_len = 0;
+
+    if(!run.count)
+        core_selection_for_each(&ctx->selection, ctx_run_cb, &state);
+
+    for(i = 0; i < run.count; i++){
+        ret = chrdev_run_get(&run, i, name, &check);
+        if(ret)
+            goto out_unlock;
+
+        if(!check){
+            ret = ctx_run_failed(ctx, name, -ENOENT);
+            if(!state.ret)
+                state.ret = ret;
+            continue;
+        }
+
+        ctx_run_cb(check, &state);
+        core_put_check(check);
+    }
+
+    ret = ctx_copy_results(ctx, run.buf, run.buf_len, &run.out_len);
+    if(state.ret)
+        ret = state.ret;
+
+    if(copy_to_user(argp, &run, sizeof(run)))
+        ret = -EFAULT;
+
+out_unlock:
+    mutex_unlock(&ctx->lock);
+    return ret;
+}
+
+static long chrdev_fetch(struct chrdev_ctx *ctx, void __user *argp){
+    struct lkmsfg_fetch fetch;
+    long ret;
+
+    if(copy_from_user(&fetch, argp, sizeof(fetch)))
+        return -EFAULT;
+
+    mutex_lock(&ctx->lock);
+    ret = ctx_copy_results(ctx, fetch.buf, fetch.buf_len, &fetch.out_len);
+    mutex_unlock(&ctx->lock);
+
+    if(copy_to_user(argp, &fetch, sizeof(fetch)))
+        return -EFAULT;
+
+    return ret;
+}
+
+/**
+ * Applies to the next runs of this fd only. The debugfs "scope" is not used here.
+ */
+static long chrdev_set_scope(struct chrdev_ctx *ctx, void __user *argp){
+    struct lkmsfg_scope uscope;
+    struct core_scope *scope;
+    char pid[16];
+
+    if(copy_from_user(&uscope, argp, sizeof(uscope)))
+        return -EFAULT;
+    uscope.cgroup[LKMSFG_PATH_MAX - 1] = '\0';
+
+    switch(uscope.type){
+    case LKMSFG_SCOPE_NONE:
+        scope = NULL;
+        break;
+    case LKMSFG_SCOPE_CGROUP:
+        scope = core_scope_create(CORE_SCOPE_CGROUP, uscope.cgroup);
+        break;
+    case LKMSFG_SCOPE_PIDNS:
+        snprintf(pid, sizeof(pid), "%d", uscope.pid);
+        scope = core_scope_create(CORE_SCOPE_PIDNS, pid);
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    if(IS_ERR(scope))
+        return PTR_ERR(scope);
+
+    mutex_lock(&ctx->lock);
+    swap(ctx->scope, scope);
+    mutex_unlock(&ctx->lock);
+
+    core_scope_put(scope);
+    return 0;
+}
+
+static long chrdev_ioctl(struct file *file, unsigned int cmd, unsigned long arg){
+    struct chrdev_ctx *ctx = file->private_data;
+    void __user *argp = (void __user *)arg;
+
+    switch(cmd){
+    case LKMSFG_IOC_BATCH:
+        return chrdev_batch(ctx, argp);
+    case LKMSFG_IOC_RUN:
+        return chrdev_run(ctx, argp);
+    case LKMSFG_IOC_FETCH:
+        return chrdev_fetch(ctx, argp);
+    case LKMSFG_IOC_SET_SCOPE:
+        return chrdev_set_scope(ctx, argp);
+    default:
+        return -ENOTTY;
+    }
+}
+
+//--------------------------------------------------------------------------------
+//File operations
+
+/**
+ * read() returns the results of the last run of this fd. Use pread() at 0, or
+ * lseek() back, to read the results of a new run.
+ */
+static ssize_t chrdev_read(struct file *file, char __user *user_buffer, size_t size, loff_t *offset){
+    struct chrdev_ctx *ctx = file->private_data;
+    ssize_t ret;
+
+    mutex_lock(&ctx->lock);
+    ret = simple_read_from_buffer(user_buffer, size, offset, ctx->results, ctx->results_len);
+    mutex_unlock(&ctx->lock);
+
+    return ret;
+}
+
+/**
+ * misc_open() leaves the miscdevice in private_data, we replace it with our context.
+ * https://docs.kernel.org/driver-api/misc_devices.html
+ */
+static int chrdev_open(struct inode *inode, struct file *file){
+    struct chrdev_ctx *ctx;
+
+    ctx = kzalloc(sizeof(*ctx), GFP_KERNEL_ACCOUNT);
+    if(!ctx)
+        return -ENOMEM;
+
+    core_selection_init(&ctx->selection);
+    mutex_init(&ctx->lock);
+
+    file->private_data = ctx;
+    return 0;
+}
+
+static int chrdev_release(struct inode *inode, struct file *file){
+    struct chrdev_ctx *ctx = file->private_data;
+
+    core_selection_destroy(&ctx->selection);
+    core_scope_put(ctx->scope);
+    mutex_destroy(&ctx->lock);
+    core_mem_add(CORE_MEM_OUTPUT, -(long)ctx->results_size);
+    kvfree(ctx->results);
+    kfree(ctx);
+
+    return 0;
+}
+
+static const struct file_operations fops_chrdev = {
+    .owner = THIS_MODULE,
+    .open = chrdev_open,
+    .release = chrdev_release,
+    .read = chrdev_read,
+    .unlocked_ioctl = chrdev_ioctl,
+    .compat_ioctl = compat_ptr_ioctl,
+    .llseek = default_llseek,
+};
+
+static struct miscdevice lkm_miscdev = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name = "lkmsfg",
+    .fops = &fops_chrdev,
+    .mode = 0600,
+};
+
+//--------------------------------------------------------------------------------
+
+int core_chrdev_init(void){
+    int ret;
+
+    ret = misc_register(&lkm_miscdev);
+    if(ret){
+        pr_err("lkm CORE: could not register /dev/lkmsfg (%d)\n", ret);
+        return ret;
+    }
+
+    pr_info("lkm CORE: /dev/lkmsfg is ready\n");
+    return 0;
+}
+
+void core_chrdev_exit(void){
+    misc_deregister(&lkm_miscdev);
+}
@@ -4,7 +4,9 @@
  */
 
 #include <linux/debugfs.h>
+#include <linux/kallsyms.h>
 #include <linux/seq_file.h>
+#include <linux/string.h>
 #include <linux/uaccess.h>
 #include <linux/slab.h>
 
@@ -12,6 +14,25 @@
 
 
 static struct dentry *lkm_dir;
+static struct dentry *results_d_dir;
+
+/**
+ * Same handling as "add"/"remove": copy the user's line into @kbuffer and
+ * replace the trailing newline left by "echo".
+ */
+static int copy_user_line(char *kbuffer, size_t kbuffer_size, const char __user *user_buffer, size_t size){
+    if (size >= kbuffer_size || size == 0)
+        return -EINVAL;
+    if (copy_from_user(kbuffer, user_buffer, size))
+        return -EFAULT;
+
+    if(kbuffer[size-1] == '\n')
+        kbuffer[size-1] = '\0';
+    else
+        kbuffer[size] = '\0';
+
+    return 0;
+}
 
 //--------------------------------------------------------------------------------
 // Available
@@ -91,21 +112,104 @@ static const struct file_operations fops_selected = {
 //--------------------------------------------------------------------------------
 // Results
 
+struct results_run{
+    struct list_head list;
+    char alias[PLUGIN_MAX_ALIAS];
+    int ret;
+    struct core_capture cap;
+};
+
+//The runs of one open "results" file
+struct results_file{
+    struct list_head runs;
+    int dropped;                //Checks that could not even be queued, -ENOMEM
+};
+
+static void results_file_free(struct results_file *rf){
+    struct results_run *run;
+    struct results_run *temp;
+
+    list_for_each_entry_safe(run, temp, &rf->runs, list){
+        list_del(&run->list);
+        if(!run->ret)
+            core_capture_release(&run->cap);
+        kfree(run);
+    }
+    kfree(rf);
+}
+
+/**
+ * Checks run into their own buffer so their output budget applies here too.
+ */
 static void results_cb(struct lkm_check *check, void*data){
-    struct seq_file *m = data;
+    struct results_file *rf = data;
+    struct results_run *run;
+
+    run = kzalloc(sizeof(*run), GFP_KERNEL_ACCOUNT);
+    if(!run){
+        rf->dropped++;
+        return;
+    }
 
-    seq_printf(m, "==== %s ====\n", check->alias);
-    check->run(m);
-    seq_printf(m, "\n");
+    strscpy(run->alias, check->alias, sizeof(run->alias));
+    run->ret = core_capture_check(check, &run->cap, CORE_READER_RESULTS);
+    list_add_tail(&run->list, &rf->runs);
 }
 
+/**
+ * If the output overflows the seq_file buffer, seq_read() calls show again
+ * with a bigger one and this output is thrown away. Show only copies the runs
+ * taken at open, so stateful checks run once per open file, and only a complete
+ * output moves sampled checks to their next slot.
+ */
 static int results_show(struct seq_file* m, void *v){
-    core_for_each_selected(results_cb, m);
+    struct results_file *rf = m->private;
+    struct results_run *run;
+
+    list_for_each_entry(run, &rf->runs, list){
+        seq_printf(m, "==== %s ====\n", run->alias);
+        core_capture_show(m, &run->cap, run->ret);
+        seq_printf(m, "\n");
+    }
+    if(rf->dropped)
+        seq_printf(m, "# %d selected checks not run: %d\n", rf->dropped, -ENOMEM);
+
+    if(!seq_has_overflowed(m)){
+        list_for_each_entry(run, &rf->runs, list){
+            if(!run->ret)
+                core_capture_delivered(&run->cap);
+        }
+    }
+
     return 0;
 }
 
+/**
+ * Every selected check runs once, here.
+ */
 static int results_open(struct inode * inode, struct file* file){
-    return single_open(file, results_show, NULL);
+    struct results_file *rf;
+    int ret;
+
+    rf = kzalloc(sizeof(*rf), GFP_KERNEL_ACCOUNT);
+    if(!rf)
+        return -ENOMEM;
+    INIT_LIST_HEAD(&rf->runs);
+
+    core_for_each_selected(results_cb, rf);
+
+    ret = single_open(file, results_show, rf);
+    if(ret)
+        results_file_free(rf);
+
+    return ret;
+}
+
+static int results_release(struct inode *inode, struct file *file){
+    struct seq_file *m = file->private_data;
+
+    results_file_free(m->private);
+    return single_release(inode, file);
 }
 
 static const struct file_operations fops_results = {
@@ -113,9 +217,279 @@ static const struct file_operations fops_results = {
     .open = results_open,
     .read = seq_read,
     .llseek = seq_lseek,
+    .release = results_release,
+};
+
+//--------------------------------------------------------------------------------
+// Scope
+
+static int scope_show(struct seq_file *m, void *v){
+    struct core_scope *scope = core_scope_get_global();
+
+    core_scope_show(scope, m);
+    core_scope_put(scope);
+    return 0;
+}
+
+static int scope_open(struct inode *inode, struct file *file){
+    return single_open(file, scope_show, NULL);
+}
+
+/**
+ * "cgroup <path>", "pidns <pid>" or "none": scope of the runs started from
+ * debugfs and triggers.
+ */
+static ssize_t scope_write(struct file* file, const char __user *user_buffer, size_t size, loff_t *offset){
+    char my_kbuffer[256];
+    char *cur = my_kbuffer;
+    char *type;
+    struct core_scope *scope;
+    int ret;
+
+    ret = copy_user_line(my_kbuffer, sizeof(my_kbuffer), user_buffer, size);
+    if(ret < 0)
+        return ret;
+
+    type = strsep(&cur, " \t");
+    cur = cur ? strim(cur) : "";
+
+    if(strcmp(type, "none") == 0 || *type == '\0')
+        scope = core_scope_create(CORE_SCOPE_NONE, NULL);
+    else if(strcmp(type, "cgroup") == 0)
+        scope = core_scope_create(CORE_SCOPE_CGROUP, cur);
+    else if(strcmp(type, "pidns") == 0)
+        scope = core_scope_create(CORE_SCOPE_PIDNS, cur);
+    else
+        return -EINVAL;
+
+    if(IS_ERR(scope))
+        return PTR_ERR(scope);
+
+    core_scope_set_global(scope);
+
+    *offset += size;
+    return size;
+}
+
+static const struct file_operations fops_scope = {
+    .owner = THIS_MODULE,
+    .open = scope_open,
+    .read = seq_read,
+    .write = scope_write,
+    .llseek = seq_lseek,
     .release = single_release,
 };
 
+//--------------------------------------------------------------------------------
+// Delta results
+
+static void results_delta_cb(struct lkm_check *check, void *data){
+    core_delta_reader_run(data, check);
+}
+
+//Same as results_show(): the checks ran at open, this only compares and prints
+static int results_delta_show(struct seq_file *m, void *v){
+    core_delta_show(m->private, m);
+    if(!seq_has_overflowed(m))
+        core_delta_reader_delivered(m->private);
+    return 0;
+}
+
+/**
+ * Each open file runs the selected checks once and keeps those runs, see
+ * core_delta_reader_run().
+ */
+static int results_delta_open(struct inode *inode, struct file *file){
+    struct core_delta_reader *reader;
+    int ret;
+
+    reader = core_delta_reader_alloc();
+    if(!reader)
+        return -ENOMEM;
+
+    core_for_each_selected(results_delta_cb, reader);
+
+    ret = single_open(file, results_delta_show, reader);
+    if(ret)
+        core_delta_reader_free(reader);
+
+    return ret;
+}
+
+/**
+ * Any write commits the runs this file showed as the new baselines, e.g.
+ * exec 3<>results_delta; cat <&3; echo >&3
+ */
+static ssize_t results_delta_write(struct file* file, const char __user *user_buffer, size_t size, loff_t *offset){
+    struct seq_file *m = file->private_data;
+
+    if(!core_delta_commit_reader(m->private))
+        return -ENODATA;
+
+    *offset += size;
+    return size;
+}
+
+static int results_delta_release(struct inode *inode, struct file *file){
+    struct seq_file *m = file->private_data;
+
+    core_delta_reader_free(m->private);
+    return single_release(inode, file);
+}
+
+static const struct file_operations fops_results_delta = {
+    .owner = THIS_MODULE,
+    .open = results_delta_open,
+    .read = seq_read,
+    .write = results_delta_write,
+    .llseek = seq_lseek,
+    .release = results_delta_release,
+};
+
+static void baseline_cb(struct lkm_check *check, void *data){
+    int *last_error = data;
+    int ret;
+
+    ret = core_delta_commit(check);
+    if(ret < 0)
+        *last_error = ret;
+}
+
+/**
+ * Commits the last run a "results_delta" reader was shown in full as the
+ * baseline of the given aliases, or of every selected check on an empty
+ * write. Nothing is run again. Best-effort, like "add": -ENODATA for checks
+ * with no run shown. To commit what one reader saw, write to its file instead.
+ */
+static ssize_t baseline_write(struct file* file, const char __user *user_buffer, size_t size, loff_t *offset){
+    char my_kbuffer[256];
+    char *cur = my_kbuffer;
+    char *token;
+    struct lkm_check *check;
+    bool any = false;
+    int last_error = 0;
+    int ret;
+
+    ret = copy_user_line(my_kbuffer, sizeof(my_kbuffer), user_buffer, size);
+    if(ret < 0)
+        return ret;
+
+    while((token = strsep(&cur, " \t,")) != NULL){
+        if(*token == '\0')
+            continue;
+
+        any = true;
+        check = core_get_check(token);
+        if(!check){
+            last_error = -ENOENT;
+            continue;
+        }
+
+        ret = core_delta_commit(check);
+        if(ret < 0)
+            last_error = ret;
+        core_put_check(check);
+    }
+
+    if(!any)
+        core_for_each_selected(baseline_cb, &last_error);
+
+    if(last_error < 0)
+        return last_error;
+
+    *offset += size;
+    return size;
+}
+
+static const struct file_operations fops_baseline = {
+    .owner = THIS_MODULE,
+    .write = baseline_write,
+};
+
+//--------------------------------------------------------------------------------
+// Results of a single check (results.d/<alias>)
+
+/**
+ * The check runs once, at open. If the output does not fit the seq_file buffer
+ * seq_read() calls show again, which only copies the same capture.
+ */
+static int results_d_show(struct seq_file *m, void *v){
+    struct core_capture *cap = m->private;
+
+    core_capture_show(m, cap, 0);
+    return 0;
+}
+
+static int results_d_open(struct inode *inode, struct file *file){
+    struct lkm_check *check = inode->i_private;
+    struct core_capture *cap;
+    int ret;
+
+    cap = kzalloc(sizeof(*cap), GFP_KERNEL_ACCOUNT);
+    if(!cap)
+        return -ENOMEM;
+
+    //What the check itself returned is shown in the file, not failed here
+    ret = core_run_cached(check, cap);
+    if(ret)
+        goto err_release;
+
+    ret = single_open(file, results_d_show, cap);
+    if(ret)
+        goto err_release;
+
+    return 0;
+
+err_release:
+    core_capture_release(cap);
+    kfree(cap);
+    return ret;
+}
+
+static int results_d_release(struct inode *inode, struct file *file){
+    struct seq_file *m = file->private_data;
+    struct core_capture *cap = m->private;
+
+    core_capture_release(cap);
+    kfree(cap);
+
+    return single_release(inode, file);
+}
+
+static const struct file_operations fops_results_d = {
+    .owner = THIS_MODULE,
+    .open = results_d_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = results_d_release,
+};
+
+/**
+ * Called by the core on registration. The check pointer is the file's
+ * i_private, it is only used after checking it is still registered.
+ */
+struct dentry *core_debugfs_add_check(struct lkm_check *check){
+    struct dentry *file;
+
+    if(IS_ERR_OR_NULL(results_d_dir))
+        return NULL;
+
+    file = debugfs_create_file(check->alias, 0444, results_d_dir, check, &fops_results_d);
+    if(IS_ERR(file)){
+        pr_warn("lkm: could not create results.d/%s (%ld)\n", check->alias, PTR_ERR(file));
+        return NULL;
+    }
+
+    return file;
+}
+
+/**
+ * Waits for the readers of the file. Must not be called holding core locks.
+ */
+void core_debugfs_remove_check(struct dentry *file){
+    debugfs_remove(file);
+}
+
 //--------------------------------------------------------------------------------
 // Add
 
@@ -283,6 +657,314 @@ static const struct file_operations fops_remove = {
     .write = remove_write,
 };
 
+//--------------------------------------------------------------------------------
+// Triggers
+
+/**
+ * Any write fires the "write" source. Runs are debounced like the other sources.
+ */
+static ssize_t trigger_write(struct file* file, const char __user *user_buffer, size_t size, loff_t *offset){
+    core_trigger_fire(CORE_TRIGGER_WRITE);
+    *offset += size;
+    return size;
+}
+
+static const struct file_operations fops_trigger = {
+    .owner = THIS_MODULE,
+    .write = trigger_write,
+};
+
+/**
+ * "<source> [alias ...]": binds checks to a source. Only the source unbinds it.
+ */
+static ssize_t trigger_bind_write(struct file* file, const char __user *user_buffer, size_t size, loff_t *offset){
+    char my_kbuffer[256];
+    char *cur = my_kbuffer;
+    char *source;
+    int ret;
+
+    ret = copy_user_line(my_kbuffer, sizeof(my_kbuffer), user_buffer, size);
+    if(ret < 0)
+        return ret;
+
+    source = strsep(&cur, " \t");
+    ret = core_trigger_bind(source, cur ? strim(cur) : "");
+    if(ret < 0)
+        return ret;
+
+    *offset += size;
+    return size;
+}
+
+static int trigger_bind_show(struct seq_file *m, void *v){
+    core_trigger_show_bindings(m);
+    return 0;
+}
+
+static int trigger_bind_open(struct inode *inode, struct file *file){
+    return single_open(file, trigger_bind_show, NULL);
+}
+
+static const struct file_operations fops_trigger_bind = {
+    .owner = THIS_MODULE,
+    .open = trigger_bind_open,
+    .read = seq_read,
+    .write = trigger_bind_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+/**
+ * Symbol to probe. An empty line removes the probe.
+ */
+static ssize_t trigger_kprobe_write(struct file* file, const char __user *user_buffer, size_t size, loff_t *offset){
+    char my_kbuffer[KSYM_NAME_LEN];
+    int ret;
+
+    ret = copy_user_line(my_kbuffer, sizeof(my_kbuffer), user_buffer, size);
+    if(ret < 0)
+        return ret;
+
+    ret = core_trigger_set_kprobe(strim(my_kbuffer));
+    if(ret < 0)
+        return ret;
+
+    *offset += size;
+    return size;
+}
+
+static const struct file_operations fops_trigger_kprobe = {
+    .owner = THIS_MODULE,
+    .write = trigger_kprobe_write,
+};
+
+static int trigger_results_show(struct seq_file *m, void *v){
+    core_trigger_show_results(m);
+    return 0;
+}
+
+static int trigger_results_open(struct inode *inode, struct file *file){
+    return single_open(file, trigger_results_show, NULL);
+}
+
+static const struct file_operations fops_trigger_results = {
+    .owner = THIS_MODULE,
+    .open = trigger_results_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+//--------------------------------------------------------------------------------
+// Boot scan
+
+static int boot_results_show(struct seq_file *m, void *v){
+    core_boot_show_results(m);
+    return 0;
+}
+
+static int boot_results_open(struct inode *inode, struct file *file){
+    return single_open(file, boot_results_show, NULL);
+}
+
+static const struct file_operations fops_boot_results = {
+    .owner = THIS_MODULE,
+    .open = boot_results_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+//--------------------------------------------------------------------------------
+// Index
+
+static int index_show(struct seq_file *m, void *v){
+    core_show_index(m);
+    return 0;
+}
+
+static int index_open(struct inode *inode, struct file *file){
+    return single_open(file, index_show, NULL);
+}
+
+static const struct file_operations fops_index = {
+    .owner = THIS_MODULE,
+    .open = index_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+//--------------------------------------------------------------------------------
+// Memory
+
+static int memory_show(struct seq_file *m, void *v){
+    core_mem_show(m);
+    return 0;
+}
+
+static int memory_open(struct inode *inode, struct file *file){
+    return single_open(file, memory_show, NULL);
+}
+
+static const struct file_operations fops_memory = {
+    .owner = THIS_MODULE,
+    .open = memory_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+/**
+ * "<alias> <bytes>": output budget of one check. 0 goes back to "output_budget".
+ */
+static ssize_t budgets_write(struct file* file, const char __user *user_buffer, size_t size, loff_t *offset){
+    char my_kbuffer[256];
+    char *cur = my_kbuffer;
+    char *name;
+    unsigned long bytes;
+    int ret;
+
+    ret = copy_user_line(my_kbuffer, sizeof(my_kbuffer), user_buffer, size);
+    if(ret < 0)
+        return ret;
+
+    name = strsep(&cur, " \t");
+    if(!cur)
+        return -EINVAL;
+
+    ret = kstrtoul(strim(cur), 0, &bytes);
+    if(ret < 0)
+        return ret;
+
+    ret = core_check_set_budget(name, bytes);
+    if(ret < 0)
+        return ret;
+
+    *offset += size;
+    return size;
+}
+
+static const struct file_operations fops_budgets = {
+    .owner = THIS_MODULE,
+    .write = budgets_write,
+};
+
+//--------------------------------------------------------------------------------
+// Sampling
+
+static int sampling_show(struct seq_file *m, void *v){
+    core_show_sampling(m);
+    return 0;
+}
+
+static int sampling_open(struct inode *inode, struct file *file){
+    return single_open(file, sampling_show, NULL);
+}
+
+/**
+ * "<alias> <rate> [seed]": the check looks at 1 in <rate> items per run.
+ * 0 or 1 turns sampling off. Setting it restarts the rotation of every reader.
+ */
+static ssize_t sampling_write(struct file* file, const char __user *user_buffer, size_t size, loff_t *offset){
+    char my_kbuffer[256];
+    char *cur = my_kbuffer;
+    char *name;
+    char *arg;
+    unsigned int rate;
+    unsigned int seed = 0;
+    int ret;
+
+    ret = copy_user_line(my_kbuffer, sizeof(my_kbuffer), user_buffer, size);
+    if(ret < 0)
+        return ret;
+
+    name = strsep(&cur, " \t");
+    arg = strsep(&cur, " \t");
+    if(!arg)
+        return -EINVAL;
+
+    ret = kstrtouint(arg, 0, &rate);
+    if(ret == 0 && cur && *strim(cur))
+        ret = kstrtouint(strim(cur), 0, &seed);
+    if(ret < 0)
+        return ret;
+
+    ret = core_check_set_sampling(name, rate, seed);
+    if(ret < 0)
+        return ret;
+
+    *offset += size;
+    return size;
+}
+
+static const struct file_operations fops_sampling = {
+    .owner = THIS_MODULE,
+    .open = sampling_open,
+    .read = seq_read,
+    .write = sampling_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+//--------------------------------------------------------------------------------
+// Background execution
+
+static int exec_show(struct seq_file *m, void *v){
+    core_exec_show(m);
+    return 0;
+}
+
+static int exec_open(struct inode *inode, struct file *file){
+    return single_open(file, exec_show, NULL);
+}
+
+/**
+ * "idle" or "normal <nice>": scheduling policy of the exec kthreads.
+ * "cpus <cpulist>": CPUs they may run on.
+ */
+static ssize_t exec_write(struct file* file, const char __user *user_buffer, size_t size, loff_t *offset){
+    char my_kbuffer[256];
+    char *cur = my_kbuffer;
+    char *cmd;
+    int nice = 0;
+    int ret;
+
+    ret = copy_user_line(my_kbuffer, sizeof(my_kbuffer), user_buffer, size);
+    if(ret < 0)
+        return ret;
+
+    cmd = strsep(&cur, " \t");
+
+    if(strcmp(cmd, "idle") == 0){
+        ret = core_exec_set_policy(true, 0);
+    } else if(strcmp(cmd, "normal") == 0){
+        if(cur)
+            ret = kstrtoint(strim(cur), 0, &nice);
+        if(ret == 0)
+            ret = core_exec_set_policy(false, nice);
+    } else if(strcmp(cmd, "cpus") == 0 && cur){
+        ret = core_exec_set_cpus(strim(cur));
+    } else {
+        ret = -EINVAL;
+    }
+
+    if(ret < 0)
+        return ret;
+
+    *offset += size;
+    return size;
+}
+
+static const struct file_operations fops_exec = {
+    .owner = THIS_MODULE,
+    .open = exec_open,
+    .read = seq_read,
+    .write = exec_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
 //--------------------------------------------------------------------------------
 
 
@@ -324,9 +1006,37 @@ int core_debugfs_init(void){
     CREATE_FILE("selected", 0444, &fops_selected);
     CREATE_FILE("results", 0444, &fops_results);
     CREATE_FILE("add", 0200, &fops_add);
+    CREATE_FILE("index", 0444, &fops_index);
     CREATE_FILE("remove", 0200, &fops_remove);
     CREATE_FILE("empty", 0200, &fops_empty);
     CREATE_FILE("addall", 0200, &fops_addall);
+    CREATE_FILE("trigger", 0200, &fops_trigger);
+    CREATE_FILE("trigger_bind", 0600, &fops_trigger_bind);
+    CREATE_FILE("trigger_kprobe", 0200, &fops_trigger_kprobe);
+    CREATE_FILE("trigger_results", 0444, &fops_trigger_results);
+
+    debugfs_create_u32("trigger_window_ms", 0600, lkm_dir, &core_trigger_window_ms);
+    debugfs_create_u32("trigger_max_delay_ms", 0600, lkm_dir, &core_trigger_max_delay_ms);
+    debugfs_create_bool("trigger_on_module", 0600, lkm_dir, &core_trigger_on_module);
+
+    CREATE_FILE("boot_results", 0444, &fops_boot_results);
+
+    CREATE_FILE("memory", 0444, &fops_memory);
+    CREATE_FILE("budgets", 0200, &fops_budgets);
+    debugfs_create_size_t("output_budget", 0600, lkm_dir, &core_output_budget);
+    CREATE_FILE("sampling", 0600, &fops_sampling);
+
+    CREATE_FILE("exec", 0600, &fops_exec);
+    debugfs_create_bool("exec_background", 0600, lkm_dir, &core_exec_background);
+    debugfs_create_u32("exec_runtime_us", 0600, lkm_dir, &core_exec_runtime_us);
+    debugfs_create_u32("exec_period_us", 0600, lkm_dir, &core_exec_period_us);
+
+    CREATE_FILE("scope", 0600, &fops_scope);
+    CREATE_FILE("results_delta", 0600, &fops_results_delta);
+    CREATE_FILE("baseline", 0200, &fops_baseline);
+
+    results_d_dir = debugfs_create_dir("results.d", lkm_dir);
+    debugfs_create_u32("cache_ms", 0600, lkm_dir, &core_cache_ms);
 
 #undef CREATE_FILE
 
@@ -343,4 +1053,5 @@ void core_debugfs_exit(void){
         debugfs_remove(lkm_dir);
     
     lkm_dir = NULL;
+    results_d_dir = NULL;
 }
\ No newline at end of file
@@ -0,0 +1,416 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * LKM: delta results against a committed baseline
+ *
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#include <linux/jhash.h>
+#include <linux/kref.h>
+#include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/string.h>
+
+#include "core_internal.h"
+
+
+/**
+ * Findings are output lines. A changed line shows up as one removed and one
+ * added line.
+ */
+struct delta_line{
+    u32 hash;
+    u32 off;
+    u32 len;
+    bool matched;
+};
+
+/**
+ * The output of one run split into lines. "lines" keeps the output order for
+ * printing, "sorted" is ordered by hash, length and text for matching.
+ * Shared by the reader that ran it and its check's state (last shown run,
+ * baseline). "matched" is only touched under the state's delta_lock.
+ */
+struct core_delta_set{
+    struct kref ref;
+    struct list_head node;      //In a reader, see below
+    char alias[PLUGIN_MAX_ALIAS];
+    int ret;                    //Of the capture, nothing else is set if it failed
+    struct core_capture cap;
+    struct delta_line *lines;
+    struct delta_line **sorted;
+    size_t nr;
+};
+
+/**
+ * The runs of one open "results_delta" file, one per selected check, taken at
+ * open. Writing to that file commits them, so concurrent readers do not see
+ * each other's runs.
+ */
+struct core_delta_reader{
+    struct mutex lock;          //Of sets: a shared fd can be read and written at once
+    struct list_head sets;
+    int dropped;                //Checks that could not even be queued, -ENOMEM
+};
+
+//--------------------------------------------------------------------------------
+//Line sets
+
+static void delta_set_release(struct kref *ref){
+    struct core_delta_set *set = container_of(ref, struct core_delta_set, ref);
+
+    if(!set->ret)
+        core_capture_release(&set->cap);
+    kvfree(set->lines);
+    kvfree(set->sorted);
+    kfree(set);
+}
+
+static struct core_delta_set *delta_set_get(struct core_delta_set *set){
+    kref_get(&set->ref);
+    return set;
+}
+
+static void delta_set_put(struct core_delta_set *set){
+    if(set)
+        kref_put(&set->ref, delta_set_release);
+}
+
+/**
+ * Total order on lines, possibly of different runs. The text is only compared
+ * when hash and length are equal.
+ */
+static int delta_line_order(const struct core_delta_set *a, const struct delta_line *la,
+    const struct core_delta_set *b, const struct delta_line *lb){
+    if(la->hash != lb->hash)
+        return la->hash < lb->hash ? -1 : 1;
+    if(la->len != lb->len)
+        return la->len < lb->len ? -1 : 1;
+    return memcmp(a->cap.buf + la->off, b->cap.buf + lb->off, la->len);
+}
+
+static int delta_line_cmp(const void *a, const void *b, const void *priv){
+    const struct core_delta_set *set = priv;
+
+    return delta_line_order(set, *(const struct delta_line * const *)a,
+        set, *(const struct delta_line * const *)b);
+}
+
+/**
+ * Runs @check and splits its output. On errors, of the run or the split, the
+ * set only holds the error.
+ * https://docs.kernel.org/core-api/kernel-api.html#c.sort_r
+ */
+static struct core_delta_set *delta_set_build(struct lkm_check *check){
+    struct core_delta_set *set;
+    const char *buf;
+    const char *nl;
+    size_t off = 0;
+    size_t nr = 0;
+    size_t i = 0;
+
+    set = kzalloc(sizeof(*set), GFP_KERNEL_ACCOUNT);
+    if(!set)
+        return NULL;
+    kref_init(&set->ref);
+
+    strscpy(set->alias, check->alias, sizeof(set->alias));
+    set->ret = core_capture_check(check, &set->cap, CORE_READER_DELTA);
+    if(set->ret)
+        return set;
+    //Unregistered meanwhile: there is no baseline to compare with
+    if(!set->cap.state){
+        core_capture_release(&set->cap);
+        set->ret = -ENOENT;
+        return set;
+    }
+    buf = set->cap.buf;
+
+    for(off = 0; off < set->cap.len; nr++){
+        nl = memchr(buf + off, '\n', set->cap.len - off);
+        off = nl ? nl - buf + 1 : set->cap.len;
+    }
+
+    if(!nr)
+        return set;
+
+    set->lines = kvcalloc(nr, sizeof(*set->lines), GFP_KERNEL_ACCOUNT);
+    set->sorted = kvcalloc(nr, sizeof(*set->sorted), GFP_KERNEL_ACCOUNT);
+    if(!set->lines || !set->sorted){
+        kvfree(set->lines);
+        kvfree(set->sorted);
+        set->lines = NULL;
+        set->sorted = NULL;
+        core_capture_release(&set->cap);
+        set->ret = -ENOMEM;
+        return set;
+    }
+
+    for(off = 0; off < set->cap.len; i++){
+        nl = memchr(buf + off, '\n', set->cap.len - off);
+
+        set->lines[i].off = off;
+        set->lines[i].len = (nl ? nl - buf : set->cap.len) - off;
+        set->lines[i].hash = jhash(buf + off, set->lines[i].len, 0);
+        set->sorted[i] = &set->lines[i];
+
+        off = nl ? nl - buf + 1 : set->cap.len;
+    }
+    set->nr = nr;
+
+    sort_r(set->sorted, nr, sizeof(*set->sorted), delta_line_cmp, NULL, set);
+
+    return set;
+}
+
+/**
+ * Merge walk over both sorted arrays, one comparison per step. Lines are a
+ * multiset: a line repeated three times in @cur and twice in @base leaves one
+ * unmatched.
+ */
+static void delta_match(struct core_delta_set *cur, struct core_delta_set *base){
+    size_t i = 0;
+    size_t j = 0;
+    int cmp;
+
+    for(size_t k = 0; k < cur->nr; k++)
+        cur->lines[k].matched = false;
+    for(size_t k = 0; k < base->nr; k++)
+        base->lines[k].matched = false;
+
+    while(i < cur->nr && j < base->nr){
+        cmp = delta_line_order(cur, cur->sorted[i], base, base->sorted[j]);
+
+        if(cmp < 0){
+            i++;
+        }else if(cmp > 0){
+            j++;
+        }else{
+            cur->sorted[i++]->matched = true;
+            base->sorted[j++]->matched = true;
+        }
+    }
+}
+
+static size_t delta_print(struct seq_file *m, struct core_delta_set *set, char sign){
+    struct delta_line *line;
+    size_t count = 0;
+
+    for(size_t k = 0; k < set->nr; k++){
+        line = &set->lines[k];
+        if(line->matched)
+            continue;
+
+        seq_printf(m, "%c %.*s\n", sign, (int)line->len, set->cap.buf + line->off);
+        count++;
+    }
+
+    return count;
+}
+
+//--------------------------------------------------------------------------------
+//Readers
+
+struct core_delta_reader *core_delta_reader_alloc(void){
+    struct core_delta_reader *reader;
+
+    reader = kzalloc(sizeof(*reader), GFP_KERNEL_ACCOUNT);
+    if(!reader)
+        return NULL;
+
+    mutex_init(&reader->lock);
+    INIT_LIST_HEAD(&reader->sets);
+
+    return reader;
+}
+
+void core_delta_reader_free(struct core_delta_reader *reader){
+    struct core_delta_set *set;
+    struct core_delta_set *temp;
+
+    if(!reader)
+        return;
+
+    list_for_each_entry_safe(set, temp, &reader->sets, node){
+        list_del(&set->node);
+        delta_set_put(set);
+    }
+    mutex_destroy(&reader->lock);
+    kfree(reader);
+}
+
+/**
+ * Makes @set the baseline of its check, or its last run shown when @shown.
+ * Checks already flushed on unregistration take neither: they would hold
+ * their state forever. The caller keeps its reference on @set.
+ */
+static void delta_set_keep(struct core_delta_set *set, bool shown){
+    struct core_check_state *state = set->cap.state;
+    struct core_delta_set **slot = shown ? &state->delta_shown : &state->delta_base;
+    struct core_delta_set *old = NULL;
+
+    mutex_lock(&state->delta_lock);
+    if(!state->delta_dead){
+        old = delta_set_get(set);
+        swap(*slot, old);
+    }
+    mutex_unlock(&state->delta_lock);
+
+    delta_set_put(old);
+}
+
+//--------------------------------------------------------------------------------
+//Delta API
+
+/**
+ * Runs @check for @reader, to be shown by core_delta_show().
+ *
+ * @check: pinned check.
+ */
+void core_delta_reader_run(struct core_delta_reader *reader, struct lkm_check *check){
+    struct core_delta_set *set;
+
+    set = delta_set_build(check);
+
+    mutex_lock(&reader->lock);
+    if(set)
+        list_add_tail(&set->node, &reader->sets);
+    else
+        reader->dropped++;
+    mutex_unlock(&reader->lock);
+}
+
+/**
+ * Prints what changed in the runs of @reader since the baselines of their
+ * checks. Runs nothing: seq_read() calls it again when the output overflows.
+ */
+void core_delta_show(struct core_delta_reader *reader, struct seq_file *m){
+    struct core_check_state *state;
+    struct core_delta_set *cur;
+    size_t added;
+    size_t removed;
+
+    mutex_lock(&reader->lock);
+    list_for_each_entry(cur, &reader->sets, node){
+        seq_printf(m, "==== %s ====\n", cur->alias);
+
+        if(cur->ret){
+            seq_printf(m, "# delta unavailable: run failed: %d\n\n", cur->ret);
+            continue;
+        }
+        state = cur->cap.state;
+        removed = 0;
+
+        mutex_lock(&state->delta_lock);
+
+        if(state->delta_base)
+            delta_match(cur, state->delta_base);
+        else
+            seq_printf(m, "# no baseline committed\n");
+
+        added = delta_print(m, cur, '+');
+        if(state->delta_base)
+            removed = delta_print(m, state->delta_base, '-');
+
+        mutex_unlock(&state->delta_lock);
+
+        if(cur->cap.ret)
+            seq_printf(m, "# run returned %d\n", cur->cap.ret);
+        seq_printf(m, "# %zu added, %zu removed, %zu unchanged\n\n", added, removed, cur->nr - added);
+    }
+
+    if(reader->dropped)
+        seq_printf(m, "# %d selected checks not run: %d\n", reader->dropped, -ENOMEM);
+    mutex_unlock(&reader->lock);
+}
+
+/**
+ * Called once the runs of @reader were shown in full. They become the last
+ * runs shown of their checks, which "baseline" commits.
+ */
+void core_delta_reader_delivered(struct core_delta_reader *reader){
+    struct core_delta_set *set;
+
+    mutex_lock(&reader->lock);
+    list_for_each_entry(set, &reader->sets, node){
+        if(set->ret)
+            continue;
+        core_capture_delivered(&set->cap);
+        delta_set_keep(set, true);
+    }
+    mutex_unlock(&reader->lock);
+}
+
+/**
+ * Commits the runs @reader showed as the baselines of their checks. The
+ * reader keeps them: reading the file again shows no changes.
+ * Returns how many were committed.
+ */
+int core_delta_commit_reader(struct core_delta_reader *reader){
+    struct core_delta_set *set;
+    int count = 0;
+
+    mutex_lock(&reader->lock);
+    list_for_each_entry(set, &reader->sets, node){
+        if(set->ret)
+            continue;
+        delta_set_keep(set, false);
+        count++;
+    }
+    mutex_unlock(&reader->lock);
+
+    return count;
+}
+
+/**
+ * Commits the last run of @check a "results_delta" reader was shown in full
+ * as its baseline. Nothing is run: a finding no reader saw never goes into a
+ * baseline. -ENODATA if no run was shown since the check registered.
+ *
+ * @check: pinned check.
+ */
+int core_delta_commit(struct lkm_check *check){
+    struct core_check_state *state;
+    struct core_delta_set *old = NULL;
+    int ret = -ENODATA;
+
+    state = core_check_state_get(check);
+    if(!state)
+        return -ENOENT;
+
+    mutex_lock(&state->delta_lock);
+    if(state->delta_shown){
+        old = delta_set_get(state->delta_shown);
+        swap(state->delta_base, old);
+        ret = 0;
+    }
+    mutex_unlock(&state->delta_lock);
+
+    delta_set_put(old);
+    core_check_state_put(state);
+    return ret;
+}
+
+/**
+ * The baseline and the last run shown hold a reference on @state, see
+ * core_check_state_flush(). Sets kept by readers go away with their file.
+ */
+void core_delta_flush(struct core_check_state *state){
+    struct core_delta_set *base;
+    struct core_delta_set *shown;
+
+    mutex_lock(&state->delta_lock);
+    state->delta_dead = true;
+    base = state->delta_base;
+    shown = state->delta_shown;
+    state->delta_base = NULL;
+    state->delta_shown = NULL;
+    mutex_unlock(&state->delta_lock);
+
+    delta_set_put(base);
+    delta_set_put(shown);
+}
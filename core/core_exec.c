@@ -0,0 +1,431 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * LKM: background execution of checks
+ *
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/refcount.h>
+#include <linux/sched.h>
+#include <linux/sched/isolation.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <uapi/linux/sched/types.h>
+
+#include "core_internal.h"
+
+
+#define EXEC_MAX_THREADS 16
+
+static unsigned int exec_threads = 1;
+module_param(exec_threads, uint, 0444);
+MODULE_PARM_DESC(exec_threads, "Number of background kthreads running checks (1-16)");
+
+/**
+ * Exposed through debugfs.
+ * @core_exec_background: run checks on the exec kthreads instead of the caller.
+ * @core_exec_runtime_us/@core_exec_period_us: CPU time the kthreads may use
+ * per period, all of them together. 0 in either disables the budget.
+ */
+bool core_exec_background;
+u32 core_exec_runtime_us;
+u32 core_exec_period_us = 1000000;
+
+/**
+ * A run handed to the kthreads. Shared by the caller and the kthread, the
+ * last one to let go frees it: a killed caller leaves the run to the kthread.
+ */
+struct exec_job{
+    struct list_head list;
+    refcount_t users;
+    struct lkm_check *check;        //Pinned by the job
+    struct core_scope *scope;
+    enum core_reader reader;
+    struct core_capture cap;
+    int ret;
+    struct completion done;
+};
+
+struct exec_worker{
+    struct task_struct *task;
+    u64 charged;                    //sum_exec_runtime already charged
+};
+
+static LIST_HEAD(exec_queue);
+static DEFINE_SPINLOCK(lock_exec_queue);
+static DECLARE_WAIT_QUEUE_HEAD(exec_wq);
+
+static struct exec_worker exec_workers[EXEC_MAX_THREADS];
+static unsigned int exec_nr_tasks;
+
+//Scheduling policy and affinity of the kthreads
+static DEFINE_MUTEX(lock_exec_cfg);
+static cpumask_var_t exec_cpus;
+static bool exec_idle = true;
+static int exec_nice = MAX_NICE;
+
+//CPU budget of the current period
+static DEFINE_SPINLOCK(lock_exec_budget);
+static u64 exec_period_start;
+static u64 exec_consumed;
+
+//--------------------------------------------------------------------------------
+//CPU budget
+
+/**
+ * Sleeps until the current period has budget left. Called before each run,
+ * and within runs from core_exec_yield().
+ */
+static void exec_throttle(void){
+    u64 runtime_ns;
+    u64 period_ns;
+    u64 now;
+    u64 wait_ns;
+
+    for(;;){
+        runtime_ns = (u64)READ_ONCE(core_exec_runtime_us) * NSEC_PER_USEC;
+        period_ns = (u64)READ_ONCE(core_exec_period_us) * NSEC_PER_USEC;
+        if(!runtime_ns || !period_ns)
+            return;
+
+        spin_lock(&lock_exec_budget);
+        now = ktime_get_ns();
+        if(now - exec_period_start >= period_ns){
+            exec_period_start = now;
+            exec_consumed = 0;
+        }
+
+        if(exec_consumed < runtime_ns){
+            spin_unlock(&lock_exec_budget);
+            return;
+        }
+
+        wait_ns = exec_period_start + period_ns - now;
+        spin_unlock(&lock_exec_budget);
+
+        if(kthread_should_stop())
+            return;
+
+        schedule_timeout_interruptible(nsecs_to_jiffies(wait_ns) + 1);
+    }
+}
+
+static void exec_charge(u64 ns){
+    spin_lock(&lock_exec_budget);
+    exec_consumed += ns;
+    spin_unlock(&lock_exec_budget);
+}
+
+/**
+ * CPU time is read from the scheduler statistics of the kthread, which are
+ * updated at least every tick: most calls have nothing to charge.
+ */
+static void exec_charge_worker(struct exec_worker *worker){
+    u64 now = current->se.sum_exec_runtime;
+
+    if(now == worker->charged)
+        return;
+
+    exec_charge(now - worker->charged);
+    worker->charged = now;
+}
+
+static struct exec_worker *exec_current_worker(void){
+    if(!(current->flags & PF_KTHREAD))
+        return NULL;
+
+    for(unsigned int i = 0; i < exec_nr_tasks; i++){
+        if(exec_workers[i].task == current)
+            return &exec_workers[i];
+    }
+    return NULL;
+}
+
+/**
+ * Charges what the current run used so far, if it runs on a kthread.
+ * Does not sleep.
+ */
+void core_exec_charge_current(void){
+    struct exec_worker *worker = exec_current_worker();
+
+    if(worker)
+        exec_charge_worker(worker);
+}
+
+/**
+ * Called from within runs, between items: a long run on the kthreads
+ * sleeps there once the budget is spent, instead of overshooting it.
+ */
+void core_exec_yield(void){
+    struct exec_worker *worker = exec_current_worker();
+
+    if(worker){
+        exec_charge_worker(worker);
+        exec_throttle();
+    }
+
+    cond_resched();
+}
+
+//--------------------------------------------------------------------------------
+//Kthreads
+
+static void exec_job_put(struct exec_job *job){
+    if(!refcount_dec_and_test(&job->users))
+        return;
+
+    core_capture_release(&job->cap);
+    core_scope_put(job->scope);
+    core_put_check(job->check);
+    kfree(job);
+}
+
+static struct exec_job *exec_pop(void){
+    struct exec_job *job = NULL;
+
+    spin_lock(&lock_exec_queue);
+    if(!list_empty(&exec_queue)){
+        job = list_first_entry(&exec_queue, struct exec_job, list);
+        list_del(&job->list);
+    }
+    spin_unlock(&lock_exec_queue);
+
+    return job;
+}
+
+static int exec_thread_fn(void *data){
+    struct exec_worker *worker = data;
+    struct exec_job *job;
+
+    while(!kthread_should_stop()){
+        wait_event_interruptible(exec_wq, !list_empty(&exec_queue) || kthread_should_stop());
+
+        job = exec_pop();
+        if(!job)
+            continue;
+
+        //Nobody waits for it anymore
+        if(refcount_read(&job->users) == 1){
+            exec_job_put(job);
+            continue;
+        }
+
+        exec_throttle();
+
+        worker->charged = current->se.sum_exec_runtime;
+        job->ret = core_capture_check_local(job->check, &job->cap, job->scope, job->reader);
+        exec_charge_worker(worker);
+
+        complete(&job->done);
+        exec_job_put(job);
+    }
+
+    return 0;
+}
+
+/**
+ * https://docs.kernel.org/scheduler/sched-design-CFS.html
+ * SCHED_IDLE only runs when nothing else wants the CPU.
+ */
+static void exec_apply(struct task_struct *task){
+    struct sched_attr attr = {
+        .sched_policy = SCHED_IDLE,
+    };
+
+    if(exec_idle)
+        sched_setattr_nocheck(task, &attr);
+    else
+        sched_set_normal(task, exec_nice);
+
+    if(set_cpus_allowed_ptr(task, exec_cpus))
+        pr_warn("lkm: could not restrict %s to CPUs %*pbl\n", task->comm, cpumask_pr_args(exec_cpus));
+}
+
+//--------------------------------------------------------------------------------
+//Submission
+
+/**
+ * Whether core_capture_check() should hand the run to the kthreads.
+ * Runs coming from the kthreads themselves stay where they are.
+ */
+bool core_exec_offload(void){
+    return READ_ONCE(core_exec_background) && exec_nr_tasks && !exec_current_worker();
+}
+
+/**
+ * Runs @check on an exec kthread and waits for it.
+ *
+ * A throttled run can take long, so the wait is killable. The job then stays
+ * with the kthread, with its own pin on @check and reference on @scope.
+ * Returns -EINTR if we were killed, -ENOENT if @check went away.
+ */
+int core_exec_capture(struct lkm_check *check, struct core_capture *cap, struct core_scope *scope,
+    enum core_reader reader){
+    struct exec_job *job;
+    int ret;
+
+    memset(cap, 0, sizeof(*cap));
+
+    job = kzalloc(sizeof(*job), GFP_KERNEL_ACCOUNT);
+    if(!job)
+        return -ENOMEM;
+
+    if(!core_pin_check(check)){
+        kfree(job);
+        return -ENOENT;
+    }
+
+    job->check = check;
+    job->scope = core_scope_get(scope);
+    job->reader = reader;
+    refcount_set(&job->users, 2);
+    init_completion(&job->done);
+
+    spin_lock(&lock_exec_queue);
+    list_add_tail(&job->list, &exec_queue);
+    spin_unlock(&lock_exec_queue);
+    wake_up(&exec_wq);
+
+    ret = wait_for_completion_killable(&job->done);
+    if(ret){
+        ret = -EINTR;
+    }else{
+        ret = job->ret;
+        *cap = job->cap;
+        memset(&job->cap, 0, sizeof(job->cap));
+    }
+
+    exec_job_put(job);
+    return ret;
+}
+
+//--------------------------------------------------------------------------------
+//Configuration
+
+/**
+ * @idle: SCHED_IDLE when true, SCHED_NORMAL with @nice otherwise.
+ */
+int core_exec_set_policy(bool idle, int nice){
+    if(nice < MIN_NICE || nice > MAX_NICE)
+        return -EINVAL;
+
+    mutex_lock(&lock_exec_cfg);
+    exec_idle = idle;
+    exec_nice = nice;
+    for(unsigned int i = 0; i < exec_nr_tasks; i++)
+        exec_apply(exec_workers[i].task);
+    mutex_unlock(&lock_exec_cfg);
+
+    return 0;
+}
+
+/**
+ * @cpulist: as in /sys/devices/system/cpu/isolated, e.g. "0-1,4".
+ */
+int core_exec_set_cpus(const char *cpulist){
+    cpumask_var_t mask;
+    int ret;
+
+    if(!zalloc_cpumask_var(&mask, GFP_KERNEL))
+        return -ENOMEM;
+
+    ret = cpulist_parse(cpulist, mask);
+    if(ret)
+        goto out_free;
+
+    if(!cpumask_intersects(mask, cpu_online_mask)){
+        ret = -EINVAL;
+        goto out_free;
+    }
+
+    mutex_lock(&lock_exec_cfg);
+    cpumask_copy(exec_cpus, mask);
+    for(unsigned int i = 0; i < exec_nr_tasks; i++)
+        exec_apply(exec_workers[i].task);
+    mutex_unlock(&lock_exec_cfg);
+
+out_free:
+    free_cpumask_var(mask);
+    return ret;
+}
+
+void core_exec_show(struct seq_file *m){
+    mutex_lock(&lock_exec_cfg);
+    seq_printf(m, "threads: %u\n", exec_nr_tasks);
+    if(exec_idle)
+        seq_printf(m, "policy: idle\n");
+    else
+        seq_printf(m, "policy: normal %d\n", exec_nice);
+    seq_printf(m, "cpus: %*pbl\n", cpumask_pr_args(exec_cpus));
+    mutex_unlock(&lock_exec_cfg);
+
+    spin_lock(&lock_exec_budget);
+    seq_printf(m, "consumed in period: %llu us\n", exec_consumed / NSEC_PER_USEC);
+    spin_unlock(&lock_exec_budget);
+}
+
+//--------------------------------------------------------------------------------
+
+/**
+ * By default the kthreads stay off isolated CPUs (isolcpus=) and off
+ * nohz_full CPUs, where the latency-sensitive workloads usually live.
+ *
+ * https://docs.kernel.org/admin-guide/kernel-parameters.html
+ */
+int core_exec_init(void){
+    struct task_struct *task;
+    unsigned int nr = clamp(exec_threads, 1U, (unsigned int)EXEC_MAX_THREADS);
+
+    if(!zalloc_cpumask_var(&exec_cpus, GFP_KERNEL))
+        return -ENOMEM;
+
+    cpumask_and(exec_cpus, housekeeping_cpumask(HK_TYPE_DOMAIN), housekeeping_cpumask(HK_TYPE_TICK));
+    if(!cpumask_intersects(exec_cpus, cpu_online_mask))
+        cpumask_copy(exec_cpus, cpu_online_mask);
+
+    mutex_lock(&lock_exec_cfg);
+    for(unsigned int i = 0; i < nr; i++){
+        task = kthread_create(exec_thread_fn, &exec_workers[i], "lkmsfg_exec/%u", i);
+        if(IS_ERR(task)){
+            pr_warn("lkm CORE: could only start %u exec kthreads\n", i);
+            break;
+        }
+
+        exec_apply(task);
+        exec_workers[i].task = task;
+        exec_nr_tasks++;
+        wake_up_process(task);
+    }
+    mutex_unlock(&lock_exec_cfg);
+
+    return 0;
+}
+
+/**
+ * Called once nothing can submit jobs anymore. Jobs still queued were given
+ * up by their callers.
+ */
+void core_exec_exit(void){
+    struct exec_job *job;
+
+    WRITE_ONCE(core_exec_background, false);
+
+    for(unsigned int i = 0; i < exec_nr_tasks; i++)
+        kthread_stop(exec_workers[i].task);
+    exec_nr_tasks = 0;
+
+    while((job = exec_pop()) != NULL)
+        exec_job_put(job);
+
+    free_cpumask_var(exec_cpus);
+}
@@ -7,11 +7,25 @@
 #ifndef _CORE_INTERNAL_H
 #define _CORE_INTERNAL_H
 
+#include <linux/atomic.h>
+#include <linux/kref.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
 #include <linux/seq_file.h>
+#include <linux/version.h>
 
 #include "lkm_check.h"
 
 
+/**
+ * A list of selected checks: the global "selected" one or a chardev fd's own.
+ */
+struct core_selection{
+    struct list_head entries;
+    struct mutex lock;
+    struct list_head node;
+};
+
 /**
  * To iterate through the lists
  */
@@ -45,10 +59,289 @@ void core_empty_selected(void);
 
 int core_addall(void);
 
+/**
+ * Same operations on any selection
+ */
+void core_selection_init(struct core_selection *selection);
+void core_selection_destroy(struct core_selection *selection);
+void core_selection_for_each(struct core_selection *selection,
+    void (*cb)(struct lkm_check *check, void *data),
+    void *data);
+int core_selection_select(struct core_selection *selection, const char *name);
+int core_selection_remove(struct core_selection *selection, const char *name);
+void core_selection_empty(struct core_selection *selection);
+int core_selection_addall(struct core_selection *selection);
+
+/**
+ * To look up a check by alias/name and pin it. Release with core_put_check()
+ */
+struct lkm_check *core_get_check(const char *name);
+struct lkm_check *core_get_check_id(u32 id);
+bool core_pin_check(struct lkm_check *check);
+void core_put_check(struct lkm_check *check);
+
+struct cgroup;
+struct core_capture;
+struct core_delta_reader;
+struct core_delta_set;
+struct dentry;
+struct pid_namespace;
+
+/**
+ * Who a run is delivered to. Each one follows its own sampling rotation, so
+ * one does not skip the slots another one was shown.
+ */
+enum core_reader{
+    CORE_READER_RESULTS,        //debugfs "results"
+    CORE_READER_SINGLE,         //results.d/<alias>
+    CORE_READER_DELTA,
+    CORE_READER_TRIGGER,
+    CORE_READER_BOOT,
+    CORE_READER_IOCTL,
+    CORE_READER_MAX,
+};
+
+/**
+ * Where a reader is in the sampling rotation of a check.
+ */
+struct core_sample_cursor{
+    u32 next;                   //Slot of its next run
+    u32 delivered;              //Slots delivered since the rate was set, up to the rate
+};
+
+/**
+ * Core-side state of a registered check. Refcounted: buffers kept from a run
+ * hold a reference so their memory can still be uncharged after unregistration.
+ */
+struct core_check_state{
+    struct kref ref;
+    size_t out_budget;          //0: use core_output_budget
+    atomic_long_t mem_used;     //Bytes of output buffers held for this check
+    atomic_long_t mem_peak;
+    atomic_t truncated;         //Runs cut at the budget
+
+    struct mutex cache_lock;
+    struct core_capture *cache; //Last run of results.d/<alias>
+    unsigned long cache_stamp;
+
+    struct mutex delta_lock;
+    struct core_delta_set *delta_base;  //Committed through "baseline"
+    struct core_delta_set *delta_shown; //Last run a results_delta reader got in full
+    bool delta_dead;                    //Flushed, takes no new baseline
+
+    struct mutex sample_lock;
+    u32 sample_rate;            //1 in sample_rate items per run. 0/1: all
+    u32 sample_seed;
+    u32 sample_gen;             //Bumped when the rate or the seed change
+    struct core_sample_cursor sample_cursors[CORE_READER_MAX];
+};
+
+struct core_check_state *core_check_state_get(struct lkm_check *check);
+void core_check_state_put(struct core_check_state *state);
+int core_check_set_budget(const char *name, size_t bytes);
+int core_check_set_sampling(const char *name, u32 rate, u32 seed);
+void core_show_sampling(struct seq_file *m);
+void core_show_check_memory(struct seq_file *m);
+void core_show_index(struct seq_file *m);
+
+/**
+ * Memory used by the core, shown in the "memory" file
+ */
+enum core_mem_kind{
+    CORE_MEM_ENTRIES,
+    CORE_MEM_SNAPSHOTS,
+    CORE_MEM_OUTPUT,
+    CORE_MEM_MAX,
+};
+
+void core_mem_add(enum core_mem_kind kind, long bytes);
+void core_mem_show(struct seq_file *m);
+
+/**
+ * Buffered runs. Output beyond the budget of the check is cut at a line
+ * boundary and a truncation marker is appended.
+ */
+#define CORE_BUDGET_MIN 256
+
+extern size_t core_output_budget;
+
+struct core_capture{
+    char *buf;
+    size_t len;
+    size_t size;
+    int ret;                    //What check->run() returned
+    struct core_check_state *state;
+
+    //Sampled runs: the slot to move past once delivered, see core_capture_delivered()
+    bool sampled;
+    bool delivered;
+    u8 reader;
+    u32 sample_gen;
+    u32 sample_slot;
+};
+
+/**
+ * Run scopes. A run limited to a cgroup and/or a PID namespace.
+ * Scopes are refcounted: a run keeps the one it started with.
+ */
+enum core_scope_type{
+    CORE_SCOPE_NONE,
+    CORE_SCOPE_CGROUP,
+    CORE_SCOPE_PIDNS,
+};
+
+struct core_scope{
+    struct kref ref;
+    struct cgroup *cgrp;
+    struct pid_namespace *pidns;
+    char desc[128];
+};
+
+struct core_scope *core_scope_create(enum core_scope_type type, const char *arg);
+struct core_scope *core_scope_get(struct core_scope *scope);
+void core_scope_put(struct core_scope *scope);
+struct core_scope *core_scope_get_global(void);
+void core_scope_set_global(struct core_scope *scope);
+void core_scope_show(struct core_scope *scope, struct seq_file *m);
+void core_scope_exit(void);
+
+/**
+ * Sampling of one run: items whose hash falls in "slot" are taken. A reader's
+ * slot moves on once it was delivered a run, so "rate" runs delivered to it
+ * take every item once.
+ */
+struct core_sample{
+    u32 rate;
+    u32 slot;
+    u32 seed;
+    u32 gen;
+    u32 covered;                //Slots of the rotation delivered, this run included
+    atomic_long_t seen;         //Items the check asked about
+    atomic_long_t taken;
+};
+
+void core_sample_begin(struct core_sample *sample, struct core_check_state *state, enum core_reader reader);
+void core_sample_restart(struct core_sample *sample);
+void core_sample_report(struct core_sample *sample, struct seq_file *m);
+void core_sample_mark(struct core_sample *sample, struct core_capture *cap, enum core_reader reader);
+void core_capture_delivered(struct core_capture *cap);
+
+/**
+ * What the core hands to a check through m->private during check->run().
+ */
+struct core_run_ctx{
+    struct lkm_check *check;
+    struct core_scope *scope;
+    struct core_sample sample;
+};
+
+int core_capture_check(struct lkm_check *check, struct core_capture *cap, enum core_reader reader);
+int core_capture_check_scoped(struct lkm_check *check, struct core_capture *cap, struct core_scope *scope,
+    enum core_reader reader);
+int core_capture_check_local(struct lkm_check *check, struct core_capture *cap, struct core_scope *scope,
+    enum core_reader reader);
+void core_capture_release(struct core_capture *cap);
+void core_capture_show(struct seq_file *m, const struct core_capture *cap, int err);
+
+/**
+ * Runs of a single check for results.d/<alias>, served from the last run
+ * while it is younger than core_cache_ms.
+ */
+extern u32 core_cache_ms;
+
+int core_run_cached(struct lkm_check *check, struct core_capture *cap);
+void core_check_state_flush(struct core_check_state *state);
+
+/**
+ * Delta results: only the lines added or removed since the baseline
+ */
+struct core_delta_reader *core_delta_reader_alloc(void);
+void core_delta_reader_free(struct core_delta_reader *reader);
+void core_delta_reader_run(struct core_delta_reader *reader, struct lkm_check *check);
+void core_delta_show(struct core_delta_reader *reader, struct seq_file *m);
+void core_delta_reader_delivered(struct core_delta_reader *reader);
+int core_delta_commit_reader(struct core_delta_reader *reader);
+int core_delta_commit(struct lkm_check *check);
+void core_delta_flush(struct core_check_state *state);
+
+/**
+ * Background execution on dedicated kthreads
+ */
+extern bool core_exec_background;
+extern u32 core_exec_runtime_us;
+extern u32 core_exec_period_us;
+
+int core_exec_init(void);
+void core_exec_exit(void);
+bool core_exec_offload(void);
+int core_exec_capture(struct lkm_check *check, struct core_capture *cap, struct core_scope *scope,
+    enum core_reader reader);
+void core_exec_charge_current(void);
+void core_exec_yield(void);
+int core_exec_set_policy(bool idle, int nice);
+int core_exec_set_cpus(const char *cpulist);
+void core_exec_show(struct seq_file *m);
+
+/**
+ * Event triggers
+ */
+enum core_trigger_source{
+    CORE_TRIGGER_WRITE,
+    CORE_TRIGGER_MODULE,
+    CORE_TRIGGER_KPROBE,
+    CORE_TRIGGER_MAX,
+};
+
+extern u32 core_trigger_window_ms;
+extern u32 core_trigger_max_delay_ms;
+extern bool core_trigger_on_module;
+
+int core_trigger_init(void);
+void core_trigger_exit(void);
+void core_trigger_fire(enum core_trigger_source src);
+int core_trigger_bind(const char *source, const char *aliases);
+int core_trigger_set_kprobe(const char *symbol);
+void core_trigger_show_bindings(struct seq_file *m);
+void core_trigger_show_results(struct seq_file *m);
+
+/**
+ * Boot-time preselection and scan (module parameters)
+ */
+void core_boot_check_registered(struct lkm_check *check);
+void core_boot_show_results(struct seq_file *m);
+void core_boot_exit(void);
+
+/**
+ * BPF checks (struct lkm_check_ops). They need struct_ops in modules (6.9)
+ * and the module's BTF.
+ */
+#if IS_ENABLED(CONFIG_BPF_JIT) && IS_ENABLED(CONFIG_DEBUG_INFO_BTF_MODULES) && \
+    LINUX_VERSION_CODE >= KERNEL_VERSION(6, 9, 0)
+#define CORE_BPF
+
+int core_bpf_init(void);
+bool core_bpf_is_check(struct lkm_check *check);
+bool core_bpf_check_tryget(struct lkm_check *check);
+void core_bpf_check_put(struct lkm_check *check);
+#else
+static inline int core_bpf_init(void){ return 0; }
+static inline bool core_bpf_is_check(struct lkm_check *check){ return false; }
+static inline bool core_bpf_check_tryget(struct lkm_check *check){ return false; }
+static inline void core_bpf_check_put(struct lkm_check *check){ }
+#endif
+
+/**
+ * Character device (/dev/lkmsfg)
+ */
+int core_chrdev_init(void);
+void core_chrdev_exit(void);
+
 /**
  * Debugfs
  */
 int core_debugfs_init(void);
 void core_debugfs_exit(void);
+struct dentry *core_debugfs_add_check(struct lkm_check *check);
+void core_debugfs_remove_check(struct dentry *file);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,401 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * LKM: buffered check runs
+ *
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#include <linux/atomic.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "core_internal.h"
+
+
+#define CORE_CAPTURE_MIN PAGE_SIZE
+
+/**
+ * Default maximum output of one check run, exposed through debugfs.
+ * Checks can get their own through the "budgets" file.
+ */
+size_t core_output_budget = 1UL << 20;
+
+/**
+ * Maximum age of the run served by results.d/<alias>. 0 always runs the check.
+ */
+u32 core_cache_ms;
+
+static atomic_long_t core_mem[CORE_MEM_MAX];
+
+static const char * const core_mem_names[CORE_MEM_MAX] = {
+    [CORE_MEM_ENTRIES]   = "entries",
+    [CORE_MEM_SNAPSHOTS] = "snapshots",
+    [CORE_MEM_OUTPUT]    = "output",
+};
+
+//--------------------------------------------------------------------------------
+//Memory accounting
+
+void core_mem_add(enum core_mem_kind kind, long bytes){
+    atomic_long_add(bytes, &core_mem[kind]);
+}
+
+void core_mem_show(struct seq_file *m){
+    long total = 0;
+    long bytes;
+
+    for(int i = 0; i < CORE_MEM_MAX; i++){
+        bytes = atomic_long_read(&core_mem[i]);
+        total += bytes;
+        seq_printf(m, "core %-10s %ld\n", core_mem_names[i], bytes);
+    }
+    seq_printf(m, "core %-10s %ld\n\n", "total", total);
+
+    seq_printf(m, "%-24s %10s %10s %10s %10s\n", "check", "budget", "used", "peak", "truncated");
+    core_show_check_memory(m);
+}
+
+static void capture_charge(struct core_capture *cap, long bytes){
+    struct core_check_state *state = cap->state;
+    long used;
+    long peak;
+
+    core_mem_add(CORE_MEM_OUTPUT, bytes);
+    if(!state)
+        return;
+
+    used = atomic_long_add_return(bytes, &state->mem_used);
+    peak = atomic_long_read(&state->mem_peak);
+    while(used > peak && !atomic_long_try_cmpxchg(&state->mem_peak, &peak, used))
+        ;
+}
+
+//--------------------------------------------------------------------------------
+//Capture
+
+/**
+ * Cuts an overflowed buffer at the last full line that leaves room for the
+ * marker, so readers never get half a line.
+ */
+static size_t capture_truncate(char *buf, size_t size){
+    char marker[64];
+    size_t mlen;
+    size_t cut;
+    size_t i;
+
+    mlen = scnprintf(marker, sizeof(marker), "[lkm: output truncated at %zu bytes]\n", size);
+    cut = size - mlen;
+
+    //No memrchr() in the kernel
+    for(i = cut; i > 0; i--){
+        if(buf[i - 1] == '\n'){
+            cut = i;
+            break;
+        }
+    }
+
+    memcpy(buf + cut, marker, mlen);
+    return cut + mlen;
+}
+
+/**
+ * Oneshot checks run into a buffer of their whole budget. Keep only what they
+ * wrote, captures can be retained for long (cache, triggers, boot scan).
+ */
+static void capture_shrink(struct core_capture *cap){
+    size_t size = max_t(size_t, cap->len, 1);
+    char *buf;
+
+    if(cap->size <= CORE_CAPTURE_MIN || size > cap->size / 2)
+        return;
+
+    buf = kvmalloc(size, GFP_KERNEL_ACCOUNT);
+    if(!buf)
+        return;
+
+    memcpy(buf, cap->buf, cap->len);
+    kvfree(cap->buf);
+    capture_charge(cap, (long)size - (long)cap->size);
+    cap->buf = buf;
+    cap->size = size;
+}
+
+/**
+ * Runs a check into a private buffer instead of a reader's seq_file, so that
+ * the output can be kept around once the run is over (triggered runs, etc).
+ *
+ * The seq_file is never opened: we only hand "buf" and "size" to the check.
+ * seq_printf() and friends mark the file as overflowed when the output does not
+ * fit, which is what single_open() relies on too. We do the same as seq_read():
+ * double the buffer and run the check again, up to the budget of the check.
+ * Checks with LKM_CHECK_F_ONESHOT run once, into a buffer of the whole budget.
+ *
+ * https://docs.kernel.org/filesystems/seq_file.html
+ *
+ * The check finds the scope and the sampling of the run through m->private.
+ *
+ * This one always runs on the calling thread, see core_capture_check().
+ */
+int core_capture_check_local(struct lkm_check *check, struct core_capture *cap, struct core_scope *scope,
+    enum core_reader reader){
+    struct core_run_ctx ctx = {
+        .check = check,
+        .scope = scope,
+    };
+    struct seq_file m;
+    size_t budget;
+    size_t size;
+    char *buf = NULL;
+    int ret = 0;
+
+    memset(cap, 0, sizeof(*cap));
+    cap->state = core_check_state_get(check);
+
+    budget = cap->state ? READ_ONCE(cap->state->out_budget) : 0;
+    if(!budget)
+        budget = max_t(size_t, READ_ONCE(core_output_budget), CORE_BUDGET_MIN);
+    size = min_t(size_t, CORE_CAPTURE_MIN, budget);
+    if(check->flags & LKM_CHECK_F_ONESHOT)
+        size = budget;
+
+    core_sample_begin(&ctx.sample, cap->state, reader);
+
+    for(;;){
+        buf = kvmalloc(size, GFP_KERNEL_ACCOUNT);
+        if(!buf){
+            ret = -ENOMEM;
+            goto out_put;
+        }
+        capture_charge(cap, size);
+
+        memset(&m, 0, sizeof(m));
+        m.buf = buf;
+        m.size = size;
+        m.private = &ctx;
+
+        core_sample_restart(&ctx.sample);
+        cap->ret = check->run(&m);
+        core_sample_report(&ctx.sample, &m);
+
+        if(!seq_has_overflowed(&m) || size >= budget)
+            break;
+
+        capture_charge(cap, -(long)size);
+        kvfree(buf);
+        size = min(size << 1, budget);
+    }
+
+    cap->buf = buf;
+    cap->size = size;
+    cap->len = m.count;
+    core_sample_mark(&ctx.sample, cap, reader);
+
+    if(seq_has_overflowed(&m)){
+        cap->len = capture_truncate(buf, size);
+        if(cap->state)
+            atomic_inc(&cap->state->truncated);
+        pr_warn("lkm: output of check %s truncated at %zu bytes\n", check->alias, size);
+    }else if(check->flags & LKM_CHECK_F_ONESHOT){
+        capture_shrink(cap);
+    }
+
+    return 0;
+
+out_put:
+    if(cap->state)
+        core_check_state_put(cap->state);
+    cap->state = NULL;
+    return ret;
+}
+
+/**
+ * Writes a run to @m, with a marker if it failed.
+ * @err: what the capture returned. @cap is not looked at if it failed.
+ */
+void core_capture_show(struct seq_file *m, const struct core_capture *cap, int err){
+    if(err){
+        seq_printf(m, "# run failed: %d\n", err);
+        return;
+    }
+
+    seq_write(m, cap->buf, cap->len);
+    if(cap->ret)
+        seq_printf(m, "# run returned %d\n", cap->ret);
+}
+
+void core_capture_release(struct core_capture *cap){
+    if(cap->buf)
+        capture_charge(cap, -(long)cap->size);
+    if(cap->state)
+        core_check_state_put(cap->state);
+
+    kvfree(cap->buf);
+    memset(cap, 0, sizeof(*cap));
+}
+
+/**
+ * @check: pinned check to run.
+ * @cap:   filled with the output. Release it with core_capture_release().
+ * @scope: scope of the run, NULL for the whole host. The caller keeps its reference.
+ * @reader: who gets the run. Call core_capture_delivered() once it got it, so
+ *          that a sampled check moves on to its next slot for @reader.
+ *
+ * In background mode the run happens on an exec kthread, while the caller
+ * sleeps. Returns 0 once the check ran, what it returned is in cap->ret.
+ * On errors of the core (-ENOMEM...) there is nothing to release in @cap.
+ */
+int core_capture_check_scoped(struct lkm_check *check, struct core_capture *cap, struct core_scope *scope,
+    enum core_reader reader){
+    if(core_exec_offload())
+        return core_exec_capture(check, cap, scope, reader);
+
+    return core_capture_check_local(check, cap, scope, reader);
+}
+
+/**
+ * Same, in the scope set through debugfs.
+ */
+int core_capture_check(struct lkm_check *check, struct core_capture *cap, enum core_reader reader){
+    struct core_scope *scope = core_scope_get_global();
+    int ret;
+
+    ret = core_capture_check_scoped(check, cap, scope, reader);
+    core_scope_put(scope);
+
+    return ret;
+}
+
+//--------------------------------------------------------------------------------
+//Check API
+
+/**
+ * To be called by long runs between items, where they would cond_resched().
+ * On the background kthreads the CPU budget is enforced here too, so a single
+ * run cannot overshoot it. May sleep.
+ */
+void core_run_yield(struct seq_file *m){
+    core_exec_yield();
+}
+EXPORT_SYMBOL_GPL(core_run_yield);
+
+//--------------------------------------------------------------------------------
+//Cached single-check runs
+
+static int capture_dup(struct core_capture *dst, const struct core_capture *src){
+    memset(dst, 0, sizeof(*dst));
+
+    dst->buf = kvmalloc(max_t(size_t, src->len, 1), GFP_KERNEL_ACCOUNT);
+    if(!dst->buf)
+        return -ENOMEM;
+
+    memcpy(dst->buf, src->buf, src->len);
+    dst->len = src->len;
+    dst->size = max_t(size_t, src->len, 1);
+    dst->ret = src->ret;
+    dst->state = src->state;
+    //The same run again: only the original moves the rotation
+    dst->sampled = false;
+    if(dst->state)
+        kref_get(&dst->state->ref);
+    capture_charge(dst, dst->size);
+
+    return 0;
+}
+
+/**
+ * Runs only @check, or copies its last run if it is recent enough.
+ * Concurrent readers of the same check wait for a single run.
+ *
+ * @check: any check pointer, it is pinned here.
+ * @cap:   filled with the output. Release it with core_capture_release().
+ *
+ * Same return as core_capture_check(), cached runs keep their cap->ret.
+ * A fresh run counts as delivered, copies of it do not move the rotation again.
+ */
+int core_run_cached(struct lkm_check *check, struct core_capture *cap){
+    struct core_check_state *state;
+    struct core_capture *fresh;
+    unsigned long max_age;
+    int ret = 0;
+
+    memset(cap, 0, sizeof(*cap));
+
+    if(!core_pin_check(check))
+        return -ENOENT;
+
+    state = core_check_state_get(check);
+    if(!state){
+        ret = -ENOENT;
+        goto out_put_check;
+    }
+
+    max_age = msecs_to_jiffies(READ_ONCE(core_cache_ms));
+
+    mutex_lock(&state->cache_lock);
+    if(max_age && state->cache && time_before(jiffies, state->cache_stamp + max_age)){
+        ret = capture_dup(cap, state->cache);
+        goto out_unlock;
+    }
+
+    if(!max_age){
+        //No caching: hand the run over directly
+        if(state->cache){
+            core_capture_release(state->cache);
+            kfree(state->cache);
+            state->cache = NULL;
+        }
+        ret = core_capture_check(check, cap, CORE_READER_SINGLE);
+        if(!ret)
+            core_capture_delivered(cap);
+        goto out_unlock;
+    }
+
+    fresh = kzalloc(sizeof(*fresh), GFP_KERNEL_ACCOUNT);
+    if(!fresh){
+        ret = -ENOMEM;
+        goto out_unlock;
+    }
+
+    ret = core_capture_check(check, fresh, CORE_READER_SINGLE);
+    if(ret){
+        kfree(fresh);
+        goto out_unlock;
+    }
+    core_capture_delivered(fresh);
+
+    if(state->cache){
+        core_capture_release(state->cache);
+        kfree(state->cache);
+    }
+    state->cache = fresh;
+    state->cache_stamp = jiffies;
+
+    ret = capture_dup(cap, fresh);
+
+out_unlock:
+    mutex_unlock(&state->cache_lock);
+    core_check_state_put(state);
+out_put_check:
+    core_put_check(check);
+    return ret;
+}
+
+/**
+ * Drops the runs kept for @state (cache, delta baseline). Called on
+ * unregistration: they hold a reference on @state, so they have to go before
+ * the state can be freed.
+ */
+void core_check_state_flush(struct core_check_state *state){
+    mutex_lock(&state->cache_lock);
+    if(state->cache){
+        core_capture_release(state->cache);
+        kfree(state->cache);
+        state->cache = NULL;
+    }
+    mutex_unlock(&state->cache_lock);
+
+    core_delta_flush(state);
+}
@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * LKM: sampled runs of expensive checks
+ *
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#include <linux/atomic.h>
+#include <linux/jhash.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+
+#include "core_internal.h"
+
+
+//--------------------------------------------------------------------------------
+//Core side
+
+/**
+ * Picks the slot of a run of @state's check for @reader. Called once per
+ * capture, before the first try: a retry with a bigger buffer must take the
+ * same items. Nothing moves until the run is delivered.
+ */
+void core_sample_begin(struct core_sample *sample, struct core_check_state *state, enum core_reader reader){
+    struct core_sample_cursor *cursor;
+
+    memset(sample, 0, sizeof(*sample));
+    if(!state)
+        return;
+
+    mutex_lock(&state->sample_lock);
+    if(state->sample_rate > 1){
+        cursor = &state->sample_cursors[reader];
+
+        sample->rate = state->sample_rate;
+        sample->seed = state->sample_seed;
+        sample->gen = state->sample_gen;
+        sample->slot = cursor->next;
+        sample->covered = min(cursor->delivered + 1, sample->rate);
+    }
+    mutex_unlock(&state->sample_lock);
+}
+
+/**
+ * Called before every try of the run.
+ */
+void core_sample_restart(struct core_sample *sample){
+    atomic_long_set(&sample->seen, 0);
+    atomic_long_set(&sample->taken, 0);
+}
+
+/**
+ * Appended to the output of a sampled run. Nothing if the check did not
+ * sample anything. The coverage counts this run, as it is the one delivered
+ * if anything is.
+ */
+void core_sample_report(struct core_sample *sample, struct seq_file *m){
+    long seen = atomic_long_read(&sample->seen);
+
+    if(!sample->rate || !seen)
+        return;
+
+    seq_printf(m, "# sampled 1/%u, slot %u, seed %u: %ld of %ld items\n", sample->rate,
+        sample->slot, sample->seed, atomic_long_read(&sample->taken), seen);
+    seq_printf(m, "# rotation coverage %u/%u slots delivered, every item is taken once every %u runs\n",
+        sample->covered, sample->rate, sample->rate);
+}
+
+/**
+ * Records in @cap which slot the run took, for core_capture_delivered().
+ */
+void core_sample_mark(struct core_sample *sample, struct core_capture *cap, enum core_reader reader){
+    cap->sampled = sample->rate > 1;
+    cap->delivered = false;
+    cap->reader = reader;
+    cap->sample_gen = sample->gen;
+    cap->sample_slot = sample->slot;
+}
+
+/**
+ * Called once @cap reached its reader (copied to a seq_file that will not be
+ * refilled, kept as a retained run...). Moves the reader's rotation past the
+ * slot of the run. Runs that were thrown away, retried or delivered already
+ * do not move it, nor do runs from before the rate or seed changed.
+ */
+void core_capture_delivered(struct core_capture *cap){
+    struct core_check_state *state = cap->state;
+    struct core_sample_cursor *cursor;
+
+    if(!cap->sampled || cap->delivered || !state)
+        return;
+    cap->delivered = true;
+
+    mutex_lock(&state->sample_lock);
+    cursor = &state->sample_cursors[cap->reader];
+    if(state->sample_gen == cap->sample_gen && state->sample_rate > 1 && cursor->next == cap->sample_slot){
+        cursor->next = (cursor->next + 1) % state->sample_rate;
+        if(cursor->delivered < state->sample_rate)
+            cursor->delivered++;
+    }
+    mutex_unlock(&state->sample_lock);
+}
+
+//--------------------------------------------------------------------------------
+//Check API
+
+static struct core_sample *sample_of(struct seq_file *m){
+    struct core_run_ctx *ctx = m->private;
+
+    return ctx && ctx->sample.rate ? &ctx->sample : NULL;
+}
+
+/**
+ * Sampling rate of the current run: the check looks at 1 in that many items.
+ * 1 when the run is not sampled.
+ */
+u32 core_sample_rate(struct seq_file *m){
+    struct core_sample *sample = sample_of(m);
+
+    return sample ? sample->rate : 1;
+}
+EXPORT_SYMBOL_GPL(core_sample_rate);
+
+/**
+ * Whether the current run looks at the item identified by @key (a PID, a page
+ * number, an address...). Keys must be stable across runs.
+ *
+ * Items are spread over "rate" slots by a hash seeded with the check's seed,
+ * and each run takes the items of one slot. Every reader of the check (debugfs
+ * results, triggers, ioctl...) moves to the next slot once it was delivered a
+ * run, so "rate" runs delivered to it take each item once. The same seed takes
+ * the same items in the same slots.
+ * Always true when the run is not sampled.
+ *
+ * Does not sleep, it can be called under RCU or from BPF. The CPU used so far
+ * is charged to the background budget, which core_run_yield() enforces.
+ */
+bool core_sample_take(struct seq_file *m, u64 key){
+    struct core_sample *sample = sample_of(m);
+    bool take;
+
+    if(!sample)
+        return true;
+
+    take = reciprocal_scale(jhash_2words((u32)key, (u32)(key >> 32), sample->seed), sample->rate) == sample->slot;
+
+    atomic_long_inc(&sample->seen);
+    if(take){
+        atomic_long_inc(&sample->taken);
+        core_exec_charge_current();
+    }
+
+    return take;
+}
+EXPORT_SYMBOL_GPL(core_sample_take);
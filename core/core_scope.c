@@ -0,0 +1,327 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * LKM: run scopes (cgroup, PID namespace)
+ *
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#include <linux/cgroup.h>
+#include <linux/idr.h>
+#include <linux/kref.h>
+#include <linux/limits.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/pid.h>
+#include <linux/pid_namespace.h>
+#include <linux/rcupdate.h>
+#include <linux/sched/signal.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "core_internal.h"
+
+
+//Scope of the runs started from debugfs and triggers. NULL: whole host.
+static struct core_scope *scope_global;
+static DEFINE_MUTEX(lock_scope_global);
+
+//--------------------------------------------------------------------------------
+//Scope objects
+
+static void scope_release(struct kref *ref){
+    struct core_scope *scope = container_of(ref, struct core_scope, ref);
+
+    if(scope->cgrp)
+        cgroup_put(scope->cgrp);
+    if(scope->pidns)
+        put_pid_ns(scope->pidns);
+    kfree(scope);
+}
+
+struct core_scope *core_scope_get(struct core_scope *scope){
+    if(scope)
+        kref_get(&scope->ref);
+    return scope;
+}
+
+void core_scope_put(struct core_scope *scope){
+    if(scope)
+        kref_put(&scope->ref, scope_release);
+}
+
+/**
+ * https://docs.kernel.org/admin-guide/cgroup-v2.html
+ * @path: relative to the cgroup2 root, e.g. "/system.slice/foo.service".
+ */
+static int scope_set_cgroup(struct core_scope *scope, const char *path){
+    struct cgroup *cgrp;
+
+    cgrp = cgroup_get_from_path(path);
+    if(IS_ERR(cgrp))
+        return PTR_ERR(cgrp);
+
+    scope->cgrp = cgrp;
+    scnprintf(scope->desc, sizeof(scope->desc), "cgroup %s", path);
+    return 0;
+}
+
+/**
+ * The namespace of @nr as seen from the caller, e.g. a container's init.
+ */
+static int scope_set_pidns(struct core_scope *scope, pid_t nr){
+    struct task_struct *task;
+    struct pid *pid;
+
+    pid = find_get_pid(nr);
+    if(!pid)
+        return -ESRCH;
+
+    task = get_pid_task(pid, PIDTYPE_PID);
+    put_pid(pid);
+    if(!task)
+        return -ESRCH;
+
+    scope->pidns = get_pid_ns(task_active_pid_ns(task));
+    put_task_struct(task);
+
+    scnprintf(scope->desc, sizeof(scope->desc), "pidns of %d", nr);
+    return 0;
+}
+
+/**
+ * @type: one of CORE_SCOPE_*.
+ * @arg:  cgroup path or PID, depending on @type.
+ *
+ * Returns a new scope, NULL for CORE_SCOPE_NONE, or an ERR_PTR.
+ */
+struct core_scope *core_scope_create(enum core_scope_type type, const char *arg){
+    struct core_scope *scope;
+    pid_t nr;
+    int ret;
+
+    if(type == CORE_SCOPE_NONE)
+        return NULL;
+
+    scope = kzalloc(sizeof(*scope), GFP_KERNEL_ACCOUNT);
+    if(!scope)
+        return ERR_PTR(-ENOMEM);
+    kref_init(&scope->ref);
+
+    switch(type){
+    case CORE_SCOPE_CGROUP:
+        ret = scope_set_cgroup(scope, arg);
+        break;
+    case CORE_SCOPE_PIDNS:
+        ret = kstrtoint(arg, 0, &nr);
+        if(!ret)
+            ret = scope_set_pidns(scope, nr);
+        break;
+    default:
+        ret = -EINVAL;
+        break;
+    }
+
+    if(ret){
+        kfree(scope);
+        return ERR_PTR(ret);
+    }
+
+    return scope;
+}
+
+//--------------------------------------------------------------------------------
+//Global scope
+
+/**
+ * Returns a reference on the global scope, NULL when runs are unscoped.
+ */
+struct core_scope *core_scope_get_global(void){
+    struct core_scope *scope;
+
+    mutex_lock(&lock_scope_global);
+    scope = scope_global;
+    if(scope)
+        kref_get(&scope->ref);
+    mutex_unlock(&lock_scope_global);
+
+    return scope;
+}
+
+/**
+ * Takes over the reference of @scope. NULL makes runs unscoped again.
+ */
+void core_scope_set_global(struct core_scope *scope){
+    struct core_scope *old;
+
+    mutex_lock(&lock_scope_global);
+    old = scope_global;
+    scope_global = scope;
+    mutex_unlock(&lock_scope_global);
+
+    core_scope_put(old);
+}
+
+void core_scope_show(struct core_scope *scope, struct seq_file *m){
+    seq_printf(m, "%s\n", scope ? scope->desc : "none");
+}
+
+//--------------------------------------------------------------------------------
+//Check API
+
+static struct core_scope *scope_of(struct seq_file *m){
+    struct core_run_ctx *ctx = m->private;
+
+    return ctx ? ctx->scope : NULL;
+}
+
+/**
+ * cgroup membership is only meaningful on the default (v2) hierarchy.
+ * Called under rcu_read_lock().
+ */
+static bool scope_task_in(struct core_scope *scope, struct task_struct *task){
+    if(!scope)
+        return true;
+
+    //Tasks of nested namespaces also have a PID in the scope's namespace
+    if(scope->pidns && !pid_nr_ns(task_tgid(task), scope->pidns))
+        return false;
+
+    if(scope->cgrp && !cgroup_is_descendant(task_dfl_cgroup(task), scope->cgrp))
+        return false;
+
+    return true;
+}
+
+/**
+ * Whether @task is in the scope of the current run.
+ * @m: the seq_file handed to check->run(). Must be called under rcu_read_lock().
+ */
+bool core_scope_task_in(struct seq_file *m, struct task_struct *task){
+    return scope_task_in(scope_of(m), task);
+}
+EXPORT_SYMBOL_GPL(core_scope_task_in);
+
+/**
+ * Description of the scope of the current run, "none" for the whole host.
+ */
+const char *core_scope_desc(struct seq_file *m){
+    struct core_scope *scope = scope_of(m);
+
+    return scope ? scope->desc : "none";
+}
+EXPORT_SYMBOL_GPL(core_scope_desc);
+
+/**
+ * Walks the thread-group leaders with a PID in [@first, @last) of @ns.
+ * Called under rcu_read_lock(). Returns what the last @cb returned.
+ */
+static int scope_walk_pids(struct core_scope *scope, struct pid_namespace *ns, int first, int last,
+    int (*cb)(struct task_struct *task, void *data),
+    void *data){
+
+    struct task_struct *task;
+    struct pid *pid;
+    int nr = first;
+    int ret = 0;
+
+    //https://elixir.bootlin.com/linux/v6.8/source/kernel/pid.c#L562 (find_ge_pid)
+    while((pid = idr_get_next(&ns->idr, &nr)) != NULL && nr < last){
+        nr++;
+
+        task = pid_task(pid, PIDTYPE_TGID);
+        if(!task)
+            continue;
+        if(scope && scope->cgrp && !cgroup_is_descendant(task_dfl_cgroup(task), scope->cgrp))
+            continue;
+
+        ret = cb(task, data);
+        if(ret)
+            break;
+    }
+
+    return ret;
+}
+
+/**
+ * Calls @cb on every process (thread-group leader) in the scope of the current run.
+ *
+ * With a PID namespace scope only the PIDs of that namespace are walked, so
+ * the cost follows the size of the tenant rather than the host.
+ *
+ * A cgroup scope is not cheaper than no scope: it walks every process and
+ * skips those outside the cgroup, it only limits what @cb sees. Walking the
+ * cgroup itself takes css_task_iter_start()/_next()/_end(), which are not
+ * exported to modules, and sfgcore is always built as one.
+ *
+ * @m:    the seq_file handed to check->run().
+ * @cb:   called under rcu_read_lock(), must not sleep. Non-zero stops the walk.
+ * @data: passed to @cb.
+ *
+ * Returns what the last @cb returned.
+ */
+int core_scope_for_each_process(struct seq_file *m,
+    int (*cb)(struct task_struct *task, void *data),
+    void *data){
+
+    struct core_scope *scope = scope_of(m);
+    struct task_struct *task;
+    int ret = 0;
+
+    rcu_read_lock();
+
+    if(scope && scope->pidns){
+        ret = scope_walk_pids(scope, scope->pidns, 1, INT_MAX, cb, data);
+        goto out_unlock;
+    }
+
+    for_each_process(task){
+        if(!scope_task_in(scope, task))
+            continue;
+
+        ret = cb(task, data);
+        if(ret)
+            break;
+    }
+
+out_unlock:
+    rcu_read_unlock();
+    return ret;
+}
+EXPORT_SYMBOL_GPL(core_scope_for_each_process);
+
+/**
+ * Same as core_scope_for_each_process(), limited to the processes whose PID is
+ * in [@first, @last). PIDs are those of the scope's namespace, or of the
+ * initial one for unscoped runs.
+ *
+ * Disjoint ranges can be walked in parallel, e.g. from work items, to shard
+ * a walk over many CPUs. The PID IDR is only read under RCU. As above, a
+ * cgroup scope walks the whole range and filters it.
+ */
+int core_scope_for_each_process_range(struct seq_file *m, int first, int last,
+    int (*cb)(struct task_struct *task, void *data),
+    void *data){
+
+    struct core_scope *scope = scope_of(m);
+    struct pid_namespace *ns = scope && scope->pidns ? scope->pidns : &init_pid_ns;
+    int ret;
+
+    if(first < 1)
+        first = 1;
+    if(first >= last)
+        return 0;
+
+    rcu_read_lock();
+    ret = scope_walk_pids(scope, ns, first, last, cb, data);
+    rcu_read_unlock();
+
+    return ret;
+}
+EXPORT_SYMBOL_GPL(core_scope_for_each_process_range);
+
+//--------------------------------------------------------------------------------
+
+void core_scope_exit(void){
+    core_scope_set_global(NULL);
+}
@@ -0,0 +1,425 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * LKM: event-triggered runs
+ *
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#include <linux/bitops.h>
+#include <linux/kallsyms.h>
+#include <linux/kprobes.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/workqueue.h>
+
+#include "core_internal.h"
+
+
+#define TRIGGER_MAX_BOUND 256
+
+/**
+ * Debounce window, cap on the delay of a run and module notifier switch,
+ * exposed through debugfs.
+ */
+u32 core_trigger_window_ms = 500;
+u32 core_trigger_max_delay_ms = 5000;
+bool core_trigger_on_module;
+
+struct trigger_source{
+    const char *name;
+    char bound[TRIGGER_MAX_BOUND];   //Space separated aliases. Empty: run "selected"
+};
+
+static struct trigger_source sources[CORE_TRIGGER_MAX] = {
+    [CORE_TRIGGER_WRITE]  = { .name = "write" },
+    [CORE_TRIGGER_MODULE] = { .name = "module" },
+    [CORE_TRIGGER_KPROBE] = { .name = "kprobe" },
+};
+
+//Bindings and kprobe configuration
+static DEFINE_MUTEX(lock_trigger);
+
+//Events fired but not yet handled by trigger_work
+static unsigned long trigger_pending;
+static atomic_t trigger_events = ATOMIC_INIT(0);
+static bool trigger_active;
+
+//Jiffies of the first event of the pending burst, 0 if none
+static unsigned long trigger_first;
+//Expiry trigger_work was last armed with
+static unsigned long trigger_armed;
+
+static void trigger_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(trigger_work, trigger_work_fn);
+
+
+struct trigger_item{
+    struct list_head list;
+    char alias[PLUGIN_MAX_ALIAS];
+    int ret;
+    struct core_capture cap;
+};
+
+struct trigger_run{
+    struct list_head items;
+    u64 seq;
+    u64 when_ms;
+    unsigned long sources;
+    int events;
+};
+
+//Last completed run, served by "trigger_results"
+static struct trigger_run *last_run;
+static u64 run_seq;
+static DEFINE_MUTEX(lock_trigger_run);
+
+//--------------------------------------------------------------------------------
+//Runs
+
+static void trigger_run_free(struct trigger_run *run){
+    struct trigger_item *pos;
+    struct trigger_item *temp;
+
+    if(!run)
+        return;
+
+    list_for_each_entry_safe(pos, temp, &run->items, list){
+        list_del(&pos->list);
+        core_capture_release(&pos->cap);
+        kfree(pos);
+    }
+    kfree(run);
+}
+
+/**
+ * Runs @check into @run unless a previous source already did.
+ * Coalescing also applies across sources bound to the same check.
+ */
+static void trigger_run_add(struct trigger_run *run, struct lkm_check *check){
+    struct trigger_item *item;
+
+    list_for_each_entry(item, &run->items, list){
+        if(strcmp(item->alias, check->alias) == 0)
+            return;
+    }
+
+    item = kzalloc(sizeof(*item), GFP_KERNEL_ACCOUNT);
+    if(!item)
+        return;
+
+    strscpy(item->alias, check->alias, sizeof(item->alias));
+    item->ret = core_capture_check(check, &item->cap, CORE_READER_TRIGGER);
+    if(!item->ret)
+        core_capture_delivered(&item->cap);
+    list_add_tail(&item->list, &run->items);
+}
+
+static void trigger_selected_cb(struct lkm_check *check, void *data){
+    trigger_run_add(data, check);
+}
+
+static void trigger_run_bound(struct trigger_run *run, char *bound){
+    struct lkm_check *check;
+    char *cur = bound;
+    char *token;
+    const char *delimiters = " \t,";
+
+    while((token = strsep(&cur, delimiters)) != NULL){
+        if(*token == '\0')
+            continue;
+
+        check = core_get_check(token);
+        if(!check)
+            continue;
+
+        trigger_run_add(run, check);
+        core_put_check(check);
+    }
+}
+
+/**
+ * Runs once per burst of events, see core_trigger_fire().
+ * Sources with bound checks run those, all the others share one run of
+ * the "selected" list.
+ */
+static void trigger_work_fn(struct work_struct *work){
+    char bound[TRIGGER_MAX_BOUND];
+    struct trigger_run *run;
+    struct trigger_run *old;
+    unsigned long pending;
+    bool selected_done = false;
+    int src;
+
+    //Events from here on start a new burst
+    WRITE_ONCE(trigger_first, 0);
+    pending = xchg(&trigger_pending, 0);
+    if(!pending)
+        return;
+
+    run = kzalloc(sizeof(*run), GFP_KERNEL_ACCOUNT);
+    if(!run)
+        return;
+
+    INIT_LIST_HEAD(&run->items);
+    run->sources = pending;
+    run->events = atomic_xchg(&trigger_events, 0);
+    run->when_ms = ktime_to_ms(ktime_get_boottime());
+
+    for_each_set_bit(src, &pending, CORE_TRIGGER_MAX){
+        mutex_lock(&lock_trigger);
+        strscpy(bound, sources[src].bound, sizeof(bound));
+        mutex_unlock(&lock_trigger);
+
+        if(bound[0] != '\0'){
+            trigger_run_bound(run, bound);
+            continue;
+        }
+
+        if(!selected_done){
+            core_for_each_selected(trigger_selected_cb, run);
+            selected_done = true;
+        }
+    }
+
+    mutex_lock(&lock_trigger_run);
+    run->seq = ++run_seq;
+    old = last_run;
+    last_run = run;
+    mutex_unlock(&lock_trigger_run);
+
+    trigger_run_free(old);
+
+    pr_info("lkm: triggered run %llu done (%d events coalesced)\n", run->seq, run->events);
+}
+
+//--------------------------------------------------------------------------------
+//Event sources
+
+/**
+ * Safe from atomic context (kprobe handlers): only touches atomics and
+ * mod_delayed_work(), which is IRQ safe.
+ *
+ * Every event pushes the run back to one window after it, so a burst runs
+ * once after its last event, however long it lasts. A steady stream (a
+ * kprobe on a hot symbol) would push it back forever: the run is never
+ * delayed more than core_trigger_max_delay_ms after the first event of the
+ * burst. Events in the same jiffy do not touch the work again.
+ */
+void core_trigger_fire(enum core_trigger_source src){
+    unsigned long now = jiffies;
+    unsigned long first;
+    unsigned long expires;
+    unsigned long deadline;
+
+    if(!READ_ONCE(trigger_active))
+        return;
+
+    set_bit(src, &trigger_pending);
+    atomic_inc(&trigger_events);
+
+    //0 marks no burst: a burst starting at jiffy 0 starts at 1
+    first = READ_ONCE(trigger_first);
+    if(!first){
+        cmpxchg(&trigger_first, 0, now ? now : 1);
+        first = READ_ONCE(trigger_first);
+        if(!first)
+            first = now;
+    }
+
+    expires = now + msecs_to_jiffies(READ_ONCE(core_trigger_window_ms));
+    deadline = first + msecs_to_jiffies(READ_ONCE(core_trigger_max_delay_ms));
+    if(time_after(expires, deadline))
+        expires = time_after(deadline, now) ? deadline : now;
+
+    if(READ_ONCE(trigger_armed) == expires && delayed_work_pending(&trigger_work))
+        return;
+
+    WRITE_ONCE(trigger_armed, expires);
+    mod_delayed_work(system_unbound_wq, &trigger_work, expires - now);
+}
+
+/**
+ * https://elixir.bootlin.com/linux/v6.8/source/include/linux/module.h#L319
+ */
+static int trigger_module_notify(struct notifier_block *nb, unsigned long action, void *data){
+    if(action == MODULE_STATE_LIVE && READ_ONCE(core_trigger_on_module))
+        core_trigger_fire(CORE_TRIGGER_MODULE);
+
+    return NOTIFY_DONE;
+}
+
+static struct notifier_block trigger_module_nb = {
+    .notifier_call = trigger_module_notify,
+};
+
+#ifdef CONFIG_KPROBES
+
+static char trigger_kp_symbol[KSYM_NAME_LEN];
+static struct kprobe trigger_kp;
+static bool trigger_kp_registered;
+
+static int trigger_kp_pre(struct kprobe *p, struct pt_regs *regs){
+    core_trigger_fire(CORE_TRIGGER_KPROBE);
+    return 0;
+}
+
+static void trigger_kprobe_clear(void){
+    if(!trigger_kp_registered)
+        return;
+
+    unregister_kprobe(&trigger_kp);
+    trigger_kp_registered = false;
+    pr_info("lkm: trigger kprobe on %s removed\n", trigger_kp_symbol);
+    trigger_kp_symbol[0] = '\0';
+}
+
+/**
+ * https://docs.kernel.org/trace/kprobes.html
+ *
+ * @symbol: function to probe. Empty string removes the current probe.
+ */
+int core_trigger_set_kprobe(const char *symbol){
+    int ret = 0;
+
+    mutex_lock(&lock_trigger);
+    trigger_kprobe_clear();
+
+    if(*symbol == '\0')
+        goto out_unlock;
+
+    memset(&trigger_kp, 0, sizeof(trigger_kp));
+    strscpy(trigger_kp_symbol, symbol, sizeof(trigger_kp_symbol));
+    trigger_kp.symbol_name = trigger_kp_symbol;
+    trigger_kp.pre_handler = trigger_kp_pre;
+
+    ret = register_kprobe(&trigger_kp);
+    if(ret < 0){
+        pr_err("lkm: could not probe %s for triggers (%d)\n", trigger_kp_symbol, ret);
+        trigger_kp_symbol[0] = '\0';
+        goto out_unlock;
+    }
+
+    trigger_kp_registered = true;
+    pr_info("lkm: trigger kprobe on %s registered\n", trigger_kp_symbol);
+
+out_unlock:
+    mutex_unlock(&lock_trigger);
+    return ret;
+}
+
+#else
+
+static void trigger_kprobe_clear(void){
+}
+
+int core_trigger_set_kprobe(const char *symbol){
+    return -EOPNOTSUPP;
+}
+
+#endif
+
+//--------------------------------------------------------------------------------
+//Configuration
+
+/**
+ * @source:  "write", "module" or "kprobe".
+ * @aliases: checks to run when it fires. Empty string unbinds (run "selected").
+ */
+int core_trigger_bind(const char *source, const char *aliases){
+    int src;
+
+    for(src = 0; src < CORE_TRIGGER_MAX; src++){
+        if(strcmp(sources[src].name, source) == 0)
+            break;
+    }
+    if(src == CORE_TRIGGER_MAX)
+        return -EINVAL;
+
+    if(strlen(aliases) >= TRIGGER_MAX_BOUND)
+        return -E2BIG;
+
+    mutex_lock(&lock_trigger);
+    strscpy(sources[src].bound, aliases, TRIGGER_MAX_BOUND);
+    mutex_unlock(&lock_trigger);
+
+    return 0;
+}
+
+void core_trigger_show_bindings(struct seq_file *m){
+    int src;
+
+    mutex_lock(&lock_trigger);
+    for(src = 0; src < CORE_TRIGGER_MAX; src++){
+        seq_printf(m, "%s: %s\n", sources[src].name,
+            sources[src].bound[0] ? sources[src].bound : "(selected)");
+    }
+#ifdef CONFIG_KPROBES
+    seq_printf(m, "kprobe symbol: %s\n",
+        trigger_kp_registered ? trigger_kp_symbol : "(none)");
+#endif
+    mutex_unlock(&lock_trigger);
+}
+
+void core_trigger_show_results(struct seq_file *m){
+    struct trigger_item *item;
+    int src;
+
+    mutex_lock(&lock_trigger_run);
+    if(!last_run){
+        seq_printf(m, "# no triggered run yet\n");
+        goto out_unlock;
+    }
+
+    seq_printf(m, "# run %llu at %llu ms, %d events coalesced, sources:",
+        last_run->seq, last_run->when_ms, last_run->events);
+    for_each_set_bit(src, &last_run->sources, CORE_TRIGGER_MAX)
+        seq_printf(m, " %s", sources[src].name);
+    seq_printf(m, "\n");
+
+    list_for_each_entry(item, &last_run->items, list){
+        seq_printf(m, "==== %s ====\n", item->alias);
+        core_capture_show(m, &item->cap, item->ret);
+        seq_printf(m, "\n");
+    }
+
+out_unlock:
+    mutex_unlock(&lock_trigger_run);
+}
+
+//--------------------------------------------------------------------------------
+
+int core_trigger_init(void){
+    int ret;
+
+    ret = register_module_notifier(&trigger_module_nb);
+    if(ret)
+        return ret;
+
+    WRITE_ONCE(trigger_active, true);
+    return 0;
+}
+
+/**
+ * Sources are shut down before flushing the work so nothing can queue it again.
+ */
+void core_trigger_exit(void){
+    WRITE_ONCE(trigger_active, false);
+
+    unregister_module_notifier(&trigger_module_nb);
+
+    mutex_lock(&lock_trigger);
+    trigger_kprobe_clear();
+    mutex_unlock(&lock_trigger);
+
+    cancel_delayed_work_sync(&trigger_work);
+
+    mutex_lock(&lock_trigger_run);
+    trigger_run_free(last_run);
+    last_run = NULL;
+    mutex_unlock(&lock_trigger_run);
+}
@@ -10,20 +10,61 @@
  * This header serves as ABI for the project.
  */
 
+#include <linux/cache.h>
 #include <linux/module.h>
 #include <linux/list.h>
 #include <linux/seq_file.h>
+#include <linux/types.h>
 
-#define LKM_CHECK_ABI_VERSION 1
+#define LKM_CHECK_ABI_V1 1
+#define LKM_CHECK_ABI_V2 2
+#define LKM_CHECK_ABI_VERSION LKM_CHECK_ABI_V2
 #define PLUGIN_MAX_NAME 64
 #define PLUGIN_MAX_ALIAS 64
 #define PLUGIN_MAX_CATEGORY 64
 
 /**
- * 
+ * Flags of a v2 check.
+ * LKM_CHECK_F_ONESHOT: run() changes state (cursors, baselines...), so it must
+ * run once per capture. The core hands it a buffer of the full output budget
+ * instead of running it again with a bigger one when the output overflows.
+ */
+#define LKM_CHECK_F_ONESHOT (1U << 0)
+#define LKM_CHECK_F_ALL LKM_CHECK_F_ONESHOT
+
+/**
+ * ABI v2.
+ *
+ * The first cache line holds what lookups and runs touch: the plugin sets
+ * abi_version, run, owner and flags, the core fills in id and the hashes when
+ * the check registers. "flags" sits in what used to be padding, so it reads 0
+ * in checks built before it existed. The strings live on the following lines and are only read
+ * for display or once a hash matched.
+ *
+ * abi_version must stay the first field in every version.
  */
 struct lkm_check {
     int abi_version;
+    u32 id;             //Set by the core, unique while registered
+    u32 name_hash;      //Set by the core
+    u32 alias_hash;     //Set by the core
+
+    int (*run)(struct seq_file *m);
+    // "run" is a function pointer that returns an integer and that takes a seq_file struct pointer
+    struct module *owner;
+    u32 flags;          //LKM_CHECK_F_*
+
+    const char name[PLUGIN_MAX_NAME] ____cacheline_aligned;
+    const char category[PLUGIN_MAX_CATEGORY];
+    const char alias[PLUGIN_MAX_ALIAS];
+};
+
+/**
+ * ABI v1, still accepted by core_register_check(): the core registers a v2
+ * copy of it. Unregister with the same pointer.
+ */
+struct lkm_check_v1 {
+    int abi_version;
     
     struct module *owner;
 
@@ -32,15 +73,51 @@ struct lkm_check {
     const char alias[PLUGIN_MAX_ALIAS];
 
     int (*run)(struct seq_file *m);
-    // "run" is a function pointer that returns an integer and that takes a seq_file struct pointer
 };
 
 
 /**
- * 
+ * @check: v2, or a struct lkm_check_v1 with abi_version set to LKM_CHECK_ABI_V1.
+ * Returns -EINVAL for unknown ABI versions and malformed checks.
  */
 int core_register_check(struct lkm_check *check);
 void core_unregister_check(struct lkm_check *check);
 
 
+/**
+ * Run scope. Runs can be limited to a cgroup or a PID namespace, checks
+ * that walk tasks should use these instead of for_each_process(). A PID
+ * namespace scope makes walks cheaper, a cgroup scope only filters them.
+ *
+ * @m is the seq_file handed to run(). Its "private" field belongs to the core.
+ */
+struct task_struct;
+
+int core_scope_for_each_process(struct seq_file *m,
+    int (*cb)(struct task_struct *task, void *data),
+    void *data);
+int core_scope_for_each_process_range(struct seq_file *m, int first, int last,
+    int (*cb)(struct task_struct *task, void *data),
+    void *data);
+bool core_scope_task_in(struct seq_file *m, struct task_struct *task);
+const char *core_scope_desc(struct seq_file *m);
+
+
+/**
+ * Long runs call this between items instead of cond_resched(), so the core
+ * can keep their CPU use within its budget. May sleep.
+ */
+void core_run_yield(struct seq_file *m);
+
+
+/**
+ * Sampling. Expensive checks can look at a subset of their items per run, at
+ * a rate set per check through the core's "sampling" file. The core rotates
+ * the subset so that every item is covered over "rate" runs delivered to the
+ * same reader, and appends the coverage to the output.
+ */
+u32 core_sample_rate(struct seq_file *m);
+bool core_sample_take(struct seq_file *m, u64 key);
+
+
 #endif
\ No newline at end of file
@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/**
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#ifndef _LKM_IOCTL_H
+#define _LKM_IOCTL_H
+
+/**
+ * This header serves as ABI for userspace agents using /dev/lkmsfg.
+ * It must only depend on uapi headers.
+ */
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+#define LKMSFG_NAME_MAX 64
+#define LKMSFG_BATCH_MAX 256
+#define LKMSFG_RUN_MAX 256
+#define LKMSFG_PATH_MAX 256
+
+/**
+ * Operations of a batch. They act on the fd's own selection.
+ */
+enum lkmsfg_op_code {
+    LKMSFG_OP_SELECT = 1,
+    LKMSFG_OP_REMOVE = 2,
+    LKMSFG_OP_EMPTY = 3,
+    LKMSFG_OP_ADDALL = 4,
+};
+
+struct lkmsfg_op {
+    __u32 code;
+    __s32 result;                   /* out: 0 or -errno */
+    char name[LKMSFG_NAME_MAX];     /* alias or name, unused by EMPTY/ADDALL */
+};
+
+/**
+ * Best-effort: every operation is attempted and gets its own result.
+ */
+struct lkmsfg_batch {
+    __u32 count;
+    __u32 failed;                   /* out: number of failed operations */
+    __u64 ops;                      /* struct lkmsfg_op[count] */
+};
+
+/**
+ * Runs checks into the fd's result context, then copies it into "buf".
+ * If it does not fit, the ioctl fails with ENOSPC and "out_len" tells the
+ * size needed. LKMSFG_IOC_FETCH or read() then return it without running again.
+ *
+ * Checks that could not be run (unknown name, out of memory...) get a
+ * "# run failed" marker and the ioctl fails with the first such error, after
+ * running the others. A check returning an error is not a failure of the ioctl: its
+ * output gets a "# run returned" marker.
+ */
+#define LKMSFG_RUN_IDS (1U << 0)     /* "names" holds IDs as shown in "index" */
+
+struct lkmsfg_run {
+    __u32 count;                    /* 0: run the fd's selection */
+    __u32 flags;                    /* LKMSFG_RUN_* */
+    __u64 names;                    /* char[count][LKMSFG_NAME_MAX], or __u32[count] with LKMSFG_RUN_IDS */
+    __u64 buf;
+    __u64 buf_len;
+    __u64 out_len;                  /* out */
+};
+
+struct lkmsfg_fetch {
+    __u64 buf;
+    __u64 buf_len;
+    __u64 out_len;                  /* out */
+};
+
+/**
+ * Scope of the runs of this fd. Checks that support it then only look at the
+ * tasks of a cgroup (v2) or of the PID namespace of a process.
+ */
+enum lkmsfg_scope_type {
+    LKMSFG_SCOPE_NONE = 0,
+    LKMSFG_SCOPE_CGROUP = 1,
+    LKMSFG_SCOPE_PIDNS = 2,
+};
+
+struct lkmsfg_scope {
+    __u32 type;
+    __s32 pid;                      /* PIDNS: any process of the namespace */
+    char cgroup[LKMSFG_PATH_MAX];   /* CGROUP: path from the cgroup2 root */
+};
+
+#define LKMSFG_IOC_MAGIC 0xF6
+
+#define LKMSFG_IOC_BATCH _IOWR(LKMSFG_IOC_MAGIC, 1, struct lkmsfg_batch)
+#define LKMSFG_IOC_RUN   _IOWR(LKMSFG_IOC_MAGIC, 2, struct lkmsfg_run)
+#define LKMSFG_IOC_FETCH _IOWR(LKMSFG_IOC_MAGIC, 3, struct lkmsfg_fetch)
+#define LKMSFG_IOC_SET_SCOPE _IOW(LKMSFG_IOC_MAGIC, 4, struct lkmsfg_scope)
+
+#endif
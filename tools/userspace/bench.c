@@ -0,0 +1,438 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * LKM: userspace harness, microbenchmark of the core registry
+ *
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/module.h>
+#include <linux/slab.h>
+
+#include "harness.h"
+
+
+/**
+ * A simulated plugin: its own module, so pins and leaks can be checked per
+ * check. Every "v1_every"th one registers through the ABI v1 shim.
+ */
+struct plugin{
+    struct module module;
+    bool v1;
+    union{
+        struct lkm_check v2;
+        struct lkm_check_v1 v1;
+    } check;
+    bool registered;
+};
+
+struct bench_cfg{
+    unsigned int checks;
+    unsigned int lookups;
+    unsigned int readers;
+    unsigned int writers;
+    unsigned int seconds;
+    unsigned int v1_every;
+    unsigned int seed;
+};
+
+static struct bench_cfg cfg = {
+    .checks = 4096,
+    .lookups = 100000,
+    .readers = 4,
+    .writers = 2,
+    .seconds = 2,
+    .v1_every = 8,
+    .seed = 1,
+};
+
+static struct plugin *plugins;
+static bool stop;
+
+//--------------------------------------------------------------------------------
+//Helpers
+
+static u64 now_ns(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void report(const char *what, unsigned long ops, u64 ns){
+    printf("%-28s %10lu ops %12.1f ns/op %14.0f ops/s\n", what, ops,
+        ops ? (double)ns / ops : 0.0, ns ? ops * 1e9 / ns : 0.0);
+}
+
+static const char *plugin_alias(struct plugin *plugin){
+    return plugin->v1 ? plugin->check.v1.alias : plugin->check.v2.alias;
+}
+
+static int plugin_run(struct seq_file *m){
+    struct core_run_ctx *ctx = m->private;
+
+    seq_printf(m, "--- %s\n", ctx->check->alias);
+    return 0;
+}
+
+static void plugin_init(struct plugin *plugin, unsigned int i){
+    snprintf(plugin->module.name, sizeof(plugin->module.name), "sfgcheck_%u", i);
+    plugin->v1 = cfg.v1_every && i % cfg.v1_every == 0;
+
+    if(plugin->v1){
+        plugin->check.v1.abi_version = LKM_CHECK_ABI_V1;
+        plugin->check.v1.owner = &plugin->module;
+        plugin->check.v1.run = plugin_run;
+        snprintf((char *)plugin->check.v1.name, PLUGIN_MAX_NAME, "check_%u", i);
+        snprintf((char *)plugin->check.v1.alias, PLUGIN_MAX_ALIAS, "c%u", i);
+        snprintf((char *)plugin->check.v1.category, PLUGIN_MAX_CATEGORY, "cat%u", i % 16);
+        return;
+    }
+
+    plugin->check.v2.abi_version = LKM_CHECK_ABI_VERSION;
+    plugin->check.v2.owner = &plugin->module;
+    plugin->check.v2.run = plugin_run;
+    snprintf((char *)plugin->check.v2.name, PLUGIN_MAX_NAME, "check_%u", i);
+    snprintf((char *)plugin->check.v2.alias, PLUGIN_MAX_ALIAS, "c%u", i);
+    snprintf((char *)plugin->check.v2.category, PLUGIN_MAX_CATEGORY, "cat%u", i % 16);
+}
+
+static int plugin_register(struct plugin *plugin){
+    int ret = core_register_check(&plugin->check.v2);
+
+    if(!ret)
+        plugin->registered = true;
+    return ret;
+}
+
+/**
+ * As a module exit does it: the module is going, so no new pins.
+ */
+static void plugin_unregister(struct plugin *plugin){
+    WRITE_ONCE(plugin->module.going, true);
+    core_unregister_check(&plugin->check.v2);
+    plugin->registered = false;
+    WRITE_ONCE(plugin->module.going, false);
+}
+
+//--------------------------------------------------------------------------------
+//Serial phases
+
+static int bench_register(void){
+    u64 start = now_ns();
+    int ret;
+
+    for(unsigned int i = 0; i < cfg.checks; i++){
+        ret = plugin_register(&plugins[i]);
+        if(ret){
+            fprintf(stderr, "register %s: %d\n", plugin_alias(&plugins[i]), ret);
+            return ret;
+        }
+    }
+
+    report("register", cfg.checks, now_ns() - start);
+    return 0;
+}
+
+static void bench_lookup(void){
+    unsigned int seed = cfg.seed;
+    struct lkm_check *check;
+    unsigned long misses = 0;
+    u32 *ids;
+    u64 start = now_ns();
+
+    for(unsigned int i = 0; i < cfg.lookups; i++){
+        check = core_get_check(plugin_alias(&plugins[rand_r(&seed) % cfg.checks]));
+        if(check)
+            core_put_check(check);
+        else
+            misses++;
+    }
+
+    report("get_check (alias)", cfg.lookups, now_ns() - start);
+    if(misses)
+        printf("  %lu lookups missed\n", misses);
+
+    //IDs are the core's, as shown in "index"
+    ids = calloc(cfg.checks, sizeof(*ids));
+    if(!ids)
+        return;
+    for(unsigned int i = 0; i < cfg.checks; i++){
+        check = core_get_check(plugin_alias(&plugins[i]));
+        if(check){
+            ids[i] = check->id;
+            core_put_check(check);
+        }
+    }
+
+    seed = cfg.seed;
+    misses = 0;
+    start = now_ns();
+
+    for(unsigned int i = 0; i < cfg.lookups; i++){
+        check = core_get_check_id(ids[rand_r(&seed) % cfg.checks]);
+        if(check)
+            core_put_check(check);
+        else
+            misses++;
+    }
+
+    report("get_check (id)", cfg.lookups, now_ns() - start);
+    if(misses)
+        printf("  %lu lookups missed\n", misses);
+    free(ids);
+}
+
+static void bench_select(void){
+    u64 start = now_ns();
+
+    for(unsigned int i = 0; i < cfg.checks; i++)
+        core_select_check(plugin_alias(&plugins[i]));
+    report("select_check", cfg.checks, now_ns() - start);
+
+    start = now_ns();
+    for(unsigned int i = 0; i < cfg.checks; i++)
+        core_remove_check(plugin_alias(&plugins[i]));
+    report("remove_check", cfg.checks, now_ns() - start);
+
+    start = now_ns();
+    core_addall();
+    report("addall", 1, now_ns() - start);
+}
+
+static void count_cb(struct lkm_check *check, void *data){
+    (*(unsigned long *)data)++;
+}
+
+static void bench_traverse(void){
+    unsigned long seen = 0;
+    unsigned int rounds = 16;
+    u64 start = now_ns();
+
+    for(unsigned int i = 0; i < rounds; i++)
+        core_for_each_selected(count_cb, &seen);
+
+    report("for_each_selected (full)", rounds, now_ns() - start);
+    if(seen != (unsigned long)rounds * cfg.checks)
+        printf("  saw %lu checks, expected %lu\n", seen, (unsigned long)rounds * cfg.checks);
+
+    core_empty_selected();
+}
+
+//--------------------------------------------------------------------------------
+//Concurrent phase
+
+struct worker{
+    pthread_t thread;
+    unsigned int seed;
+    bool churn;
+    unsigned long ops;
+};
+
+/**
+ * Readers run every selected check into a small seq_file, as "results" does.
+ */
+static void run_cb(struct lkm_check *check, void *data){
+    struct core_run_ctx ctx = {
+        .check = check,
+    };
+    char buf[128];
+    struct seq_file m = {
+        .buf = buf,
+        .size = sizeof(buf),
+        .private = &ctx,
+    };
+
+    check->run(&m);
+    (*(unsigned long *)data)++;
+}
+
+static void *reader_fn(void *arg){
+    struct worker *worker = arg;
+    unsigned long runs = 0;
+
+    while(!__atomic_load_n(&stop, __ATOMIC_RELAXED)){
+        core_for_each_selected(run_cb, &runs);
+        worker->ops++;
+    }
+
+    return NULL;
+}
+
+/**
+ * Writers select and remove random checks. The first one also unregisters and
+ * registers one again now and then, like a plugin being reloaded. v1 checks
+ * are left alone: their v2 copy is freed on unregistration, which a reader
+ * still running it would not survive (in the kernel the module pin prevents it).
+ */
+static void *writer_fn(void *arg){
+    struct worker *worker = arg;
+    struct plugin *plugin;
+    unsigned int r;
+
+    while(!__atomic_load_n(&stop, __ATOMIC_RELAXED)){
+        r = rand_r(&worker->seed);
+        plugin = &plugins[r % cfg.checks];
+
+        if(worker->churn && r % 64 == 0 && !plugin->v1){
+            plugin_unregister(plugin);
+            plugin_register(plugin);
+        }else if(r & 1){
+            core_select_check(plugin_alias(plugin));
+        }else{
+            core_remove_check(plugin_alias(plugin));
+        }
+        worker->ops++;
+    }
+
+    return NULL;
+}
+
+static void bench_contention(void){
+    struct worker *workers;
+    unsigned int nr = cfg.readers + cfg.writers;
+    unsigned long reads = 0;
+    unsigned long writes = 0;
+    u64 start;
+    u64 elapsed;
+
+    if(!nr || !cfg.seconds)
+        return;
+
+    workers = calloc(nr, sizeof(*workers));
+    if(!workers)
+        return;
+
+    //Start from a half-full selection
+    for(unsigned int i = 0; i < cfg.checks; i += 2)
+        core_select_check(plugin_alias(&plugins[i]));
+
+    stop = false;
+    start = now_ns();
+    for(unsigned int i = 0; i < nr; i++){
+        workers[i].seed = cfg.seed + i;
+        workers[i].churn = i == cfg.readers;
+        pthread_create(&workers[i].thread, NULL, i < cfg.readers ? reader_fn : writer_fn, &workers[i]);
+    }
+
+    sleep(cfg.seconds);
+    __atomic_store_n(&stop, true, __ATOMIC_RELAXED);
+
+    for(unsigned int i = 0; i < nr; i++){
+        pthread_join(workers[i].thread, NULL);
+        if(i < cfg.readers)
+            reads += workers[i].ops;
+        else
+            writes += workers[i].ops;
+    }
+    elapsed = now_ns() - start;
+
+    printf("contention: %u readers, %u writers, %u s\n", cfg.readers, cfg.writers, cfg.seconds);
+    report("  selection traversals", reads, elapsed);
+    report("  select/remove", writes, elapsed);
+
+    core_empty_selected();
+    free(workers);
+}
+
+//--------------------------------------------------------------------------------
+
+/**
+ * Once everything is unregistered no pin and no accounted byte may be left.
+ */
+static int bench_check_leaks(void){
+    int leaks = 0;
+
+    for(unsigned int i = 0; i < cfg.checks; i++){
+        if(atomic_read(&plugins[i].module.refcnt)){
+            fprintf(stderr, "leak: %s still pinned %d times\n", plugins[i].module.name,
+                atomic_read(&plugins[i].module.refcnt));
+            leaks++;
+        }
+    }
+
+    for(int kind = 0; kind < CORE_MEM_MAX; kind++){
+        if(stub_mem_bytes(kind)){
+            fprintf(stderr, "leak: %ld bytes of accounted memory (kind %d)\n", stub_mem_bytes(kind), kind);
+            leaks++;
+        }
+    }
+
+    return leaks;
+}
+
+static void usage(const char *prog){
+    fprintf(stderr,
+        "usage: %s [-n checks] [-l lookups] [-r readers] [-w writers] [-t seconds]\n"
+        "          [-1 v1_every] [-s seed] [-v]\n", prog);
+}
+
+int main(int argc, char **argv){
+    int opt;
+    int ret;
+
+    while((opt = getopt(argc, argv, "n:l:r:w:t:1:s:vh")) != -1){
+        switch(opt){
+        case 'n': cfg.checks = strtoul(optarg, NULL, 0); break;
+        case 'l': cfg.lookups = strtoul(optarg, NULL, 0); break;
+        case 'r': cfg.readers = strtoul(optarg, NULL, 0); break;
+        case 'w': cfg.writers = strtoul(optarg, NULL, 0); break;
+        case 't': cfg.seconds = strtoul(optarg, NULL, 0); break;
+        case '1': cfg.v1_every = strtoul(optarg, NULL, 0); break;
+        case 's': cfg.seed = strtoul(optarg, NULL, 0); break;
+        case 'v': shim_loglevel = 7; break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if(!cfg.checks){
+        usage(argv[0]);
+        return 2;
+    }
+
+    plugins = kcalloc(cfg.checks, sizeof(*plugins), GFP_KERNEL);
+    if(!plugins)
+        return 1;
+    for(unsigned int i = 0; i < cfg.checks; i++)
+        plugin_init(&plugins[i], i);
+
+    ret = shim_module_init();
+    if(ret){
+        fprintf(stderr, "core init: %d\n", ret);
+        return 1;
+    }
+
+    printf("checks: %u (1 in %u through ABI v1)\n", cfg.checks, cfg.v1_every);
+
+    ret = bench_register();
+    if(!ret){
+        bench_lookup();
+        bench_select();
+        bench_traverse();
+        bench_contention();
+    }
+
+    u64 start = now_ns();
+    for(unsigned int i = 0; i < cfg.checks; i++){
+        if(plugins[i].registered)
+            plugin_unregister(&plugins[i]);
+    }
+    report("unregister", cfg.checks, now_ns() - start);
+
+    if(bench_check_leaks())
+        ret = 1;
+
+    shim_module_exit();
+    kfree(plugins);
+
+    return ret ? 1 : 0;
+}
@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * LKM: userspace harness, declarations shared by the harness units
+ *
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#ifndef _HARNESS_H
+#define _HARNESS_H
+
+#include "core_internal.h"
+
+/**
+ * Provided by the shim and the stubs, on top of the kernel API they emulate.
+ */
+extern struct module __this_module;
+
+long stub_mem_bytes(enum core_mem_kind kind);
+int shim_module_init(void);
+void shim_module_exit(void);
+
+#endif
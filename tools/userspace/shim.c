@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * LKM: userspace harness, runtime of the kernel API shim
+ *
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <linux/idr.h>
+#include <linux/module.h>
+#include <linux/printk.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+
+int shim_loglevel = 3;
+
+//The core itself
+struct module __this_module = {
+    .name = "sfgcore",
+};
+
+//--------------------------------------------------------------------------------
+//printk
+
+void shim_printk(int level, const char *fmt, ...){
+    va_list args;
+
+    if(level > shim_loglevel)
+        return;
+
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+}
+
+//--------------------------------------------------------------------------------
+//Allocation
+
+void *kmalloc(size_t size, gfp_t flags){
+    void *ptr;
+
+    if(posix_memalign(&ptr, L1_CACHE_BYTES, size ? size : 1))
+        return NULL;
+    return ptr;
+}
+
+void *kzalloc(size_t size, gfp_t flags){
+    void *ptr = kmalloc(size, flags);
+
+    if(ptr)
+        memset(ptr, 0, size);
+    return ptr;
+}
+
+void *kcalloc(size_t n, size_t size, gfp_t flags){
+    if(size && n > SIZE_MAX / size)
+        return NULL;
+    return kzalloc(n * size, flags);
+}
+
+void kfree(const void *ptr){
+    free((void *)ptr);
+}
+
+struct kmem_cache *kmem_cache_create(const char *name, size_t size, size_t align,
+    unsigned long flags, void (*ctor)(void *)){
+    struct kmem_cache *cache = kzalloc(sizeof(*cache), GFP_KERNEL);
+
+    if(!cache)
+        return NULL;
+
+    cache->name = name;
+    cache->size = size;
+    return cache;
+}
+
+void kmem_cache_destroy(struct kmem_cache *cache){
+    kfree(cache);
+}
+
+void *kmem_cache_zalloc(struct kmem_cache *cache, gfp_t flags){
+    return kzalloc(cache->size, flags);
+}
+
+void kmem_cache_free(struct kmem_cache *cache, void *obj){
+    kfree(obj);
+}
+
+//--------------------------------------------------------------------------------
+//Modules
+
+bool try_module_get(struct module *module){
+    if(!module)
+        return true;
+    if(READ_ONCE(module->going))
+        return false;
+
+    atomic_inc(&module->refcnt);
+    return true;
+}
+
+void module_put(struct module *module){
+    if(module)
+        atomic_dec_and_test(&module->refcnt);
+}
+
+//--------------------------------------------------------------------------------
+//seq_file
+
+void seq_printf(struct seq_file *m, const char *fmt, ...){
+    va_list args;
+    int len;
+
+    if(m->count >= m->size)
+        return;
+
+    va_start(args, fmt);
+    len = vsnprintf(m->buf + m->count, m->size - m->count, fmt, args);
+    va_end(args);
+
+    if(len < 0 || (size_t)len >= m->size - m->count)
+        m->count = m->size;
+    else
+        m->count += len;
+}
+
+void seq_write(struct seq_file *m, const void *data, size_t len){
+    if(m->count + len >= m->size){
+        m->count = m->size;
+        return;
+    }
+
+    memcpy(m->buf + m->count, data, len);
+    m->count += len;
+}
+
+//--------------------------------------------------------------------------------
+//IDA
+
+#define IDA_BITS_PER_LONG (8 * sizeof(unsigned long))
+
+int ida_alloc_min(struct ida *ida, unsigned int min, gfp_t gfp){
+    unsigned long *bits;
+    unsigned int nbits;
+    unsigned int id;
+    int ret = -ENOSPC;
+
+    mutex_lock(&ida->lock);
+
+    for(id = min; id < ida->nbits; id++){
+        if(ida->bits[id / IDA_BITS_PER_LONG] == ~0UL){
+            id |= IDA_BITS_PER_LONG - 1;
+            continue;
+        }
+        if(!(ida->bits[id / IDA_BITS_PER_LONG] & (1UL << (id % IDA_BITS_PER_LONG))))
+            goto out_set;
+    }
+
+    nbits = max(ida->nbits * 2, max(min + 1, (unsigned int)IDA_BITS_PER_LONG));
+    nbits = (nbits + IDA_BITS_PER_LONG - 1) / IDA_BITS_PER_LONG * IDA_BITS_PER_LONG;
+    bits = realloc(ida->bits, nbits / 8);
+    if(!bits){
+        ret = -ENOMEM;
+        goto out_unlock;
+    }
+    memset((char *)bits + ida->nbits / 8, 0, (nbits - ida->nbits) / 8);
+
+    id = max(min, ida->nbits);
+    ida->bits = bits;
+    ida->nbits = nbits;
+
+out_set:
+    ida->bits[id / IDA_BITS_PER_LONG] |= 1UL << (id % IDA_BITS_PER_LONG);
+    ret = id;
+out_unlock:
+    mutex_unlock(&ida->lock);
+    return ret;
+}
+
+void ida_free(struct ida *ida, unsigned int id){
+    mutex_lock(&ida->lock);
+    if(id < ida->nbits)
+        ida->bits[id / IDA_BITS_PER_LONG] &= ~(1UL << (id % IDA_BITS_PER_LONG));
+    mutex_unlock(&ida->lock);
+}
+
+void ida_destroy(struct ida *ida){
+    mutex_lock(&ida->lock);
+    free(ida->bits);
+    ida->bits = NULL;
+    ida->nbits = 0;
+    mutex_unlock(&ida->lock);
+}
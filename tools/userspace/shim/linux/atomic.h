@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#ifndef _SHIM_LINUX_ATOMIC_H
+#define _SHIM_LINUX_ATOMIC_H
+
+#include <linux/types.h>
+
+/**
+ * Fully ordered like the kernel's value-returning atomics. Plain reads and
+ * sets are relaxed.
+ */
+typedef struct{
+    int counter;
+} atomic_t;
+
+typedef struct{
+    long counter;
+} atomic_long_t;
+
+#define ATOMIC_INIT(i) { (i) }
+#define ATOMIC_LONG_INIT(i) { (i) }
+
+static inline int atomic_read(const atomic_t *v){
+    return __atomic_load_n(&v->counter, __ATOMIC_RELAXED);
+}
+
+static inline void atomic_set(atomic_t *v, int i){
+    __atomic_store_n(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+static inline void atomic_inc(atomic_t *v){
+    __atomic_add_fetch(&v->counter, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline int atomic_inc_return(atomic_t *v){
+    return __atomic_add_fetch(&v->counter, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline bool atomic_inc_not_zero(atomic_t *v){
+    int old = atomic_read(v);
+
+    do{
+        if(!old)
+            return false;
+    }while(!__atomic_compare_exchange_n(&v->counter, &old, old + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+
+    return true;
+}
+
+static inline bool atomic_dec_and_test(atomic_t *v){
+    return __atomic_sub_fetch(&v->counter, 1, __ATOMIC_SEQ_CST) == 0;
+}
+
+static inline long atomic_long_read(const atomic_long_t *v){
+    return __atomic_load_n(&v->counter, __ATOMIC_RELAXED);
+}
+
+static inline void atomic_long_set(atomic_long_t *v, long i){
+    __atomic_store_n(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+static inline long atomic_long_add_return(long i, atomic_long_t *v){
+    return __atomic_add_fetch(&v->counter, i, __ATOMIC_SEQ_CST);
+}
+
+static inline void atomic_long_add(long i, atomic_long_t *v){
+    __atomic_add_fetch(&v->counter, i, __ATOMIC_SEQ_CST);
+}
+
+#endif
@@ -0,0 +1,15 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#ifndef _SHIM_LINUX_BUILD_BUG_H
+#define _SHIM_LINUX_BUILD_BUG_H
+
+//As in the kernel: the message is optional
+#define static_assert(expr, ...) __static_assert(expr, ##__VA_ARGS__, #expr)
+#define __static_assert(expr, msg, ...) _Static_assert(expr, msg)
+
+#define BUILD_BUG_ON(cond) _Static_assert(!(cond), #cond)
+
+#endif
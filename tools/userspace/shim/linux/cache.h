@@ -0,0 +1,12 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#ifndef _SHIM_LINUX_CACHE_H
+#define _SHIM_LINUX_CACHE_H
+
+#define L1_CACHE_BYTES 64
+#define ____cacheline_aligned __attribute__((__aligned__(L1_CACHE_BYTES)))
+
+#endif
@@ -0,0 +1,12 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#ifndef _SHIM_LINUX_DEBUGFS_H
+#define _SHIM_LINUX_DEBUGFS_H
+
+//The harness has no debugfs: files are stubbed out, see stubs.c
+struct dentry;
+
+#endif
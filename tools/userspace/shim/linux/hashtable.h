@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#ifndef _SHIM_LINUX_HASHTABLE_H
+#define _SHIM_LINUX_HASHTABLE_H
+
+#include <linux/list.h>
+#include <linux/types.h>
+
+/**
+ * Fixed-size tables of hash lists, with the kernel's bucket choice for 32-bit
+ * keys (hash_32()).
+ */
+
+#define GOLDEN_RATIO_32 0x61C88647
+
+static inline u32 hash_32(u32 val, unsigned int bits){
+    return (val * GOLDEN_RATIO_32) >> (32 - bits);
+}
+
+#define DEFINE_HASHTABLE(name, bits) \
+    struct hlist_head name[1 << (bits)] = { [0 ... ((1 << (bits)) - 1)] = HLIST_HEAD_INIT }
+
+#define HASH_SIZE(name) (sizeof(name) / sizeof((name)[0]))
+#define HASH_BITS(name) __builtin_ctz(HASH_SIZE(name))
+
+#define hash_min(val, bits) hash_32((u32)(val), bits)
+
+#define hash_add(table, node, key) \
+    hlist_add_head(node, &(table)[hash_min(key, HASH_BITS(table))])
+
+static inline void hash_del(struct hlist_node *node){
+    hlist_del_init(node);
+}
+
+#define hash_for_each_possible(table, obj, member, key) \
+    hlist_for_each_entry(obj, &(table)[hash_min(key, HASH_BITS(table))], member)
+
+#endif
@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#ifndef _SHIM_LINUX_IDR_H
+#define _SHIM_LINUX_IDR_H
+
+#include <linux/mutex.h>
+#include <linux/types.h>
+
+/**
+ * A growing bitmap: enough for IDs of registered checks.
+ */
+struct ida{
+    struct mutex lock;
+    unsigned long *bits;
+    unsigned int nbits;
+};
+
+#define DEFINE_IDA(name) struct ida name = { .lock = __MUTEX_INITIALIZER(name.lock) }
+
+int ida_alloc_min(struct ida *ida, unsigned int min, gfp_t gfp);
+void ida_free(struct ida *ida, unsigned int id);
+void ida_destroy(struct ida *ida);
+
+#endif
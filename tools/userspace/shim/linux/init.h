@@ -0,0 +1,12 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#ifndef _SHIM_LINUX_INIT_H
+#define _SHIM_LINUX_INIT_H
+
+#define __init
+#define __exit
+
+#endif
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#ifndef _SHIM_LINUX_JHASH_H
+#define _SHIM_LINUX_JHASH_H
+
+#include <string.h>
+
+#include <linux/types.h>
+
+/**
+ * Bob Jenkins' lookup3, same values as the kernel's jhash().
+ */
+#define JHASH_INITVAL 0xdeadbeef
+
+static inline u32 rol32(u32 word, unsigned int shift){
+    return (word << (shift & 31)) | (word >> ((-shift) & 31));
+}
+
+#define __jhash_mix(a, b, c) do{ \
+    a -= c; a ^= rol32(c, 4);  c += b; \
+    b -= a; b ^= rol32(a, 6);  a += c; \
+    c -= b; c ^= rol32(b, 8);  b += a; \
+    a -= c; a ^= rol32(c, 16); c += b; \
+    b -= a; b ^= rol32(a, 19); a += c; \
+    c -= b; c ^= rol32(b, 4);  b += a; \
+}while(0)
+
+#define __jhash_final(a, b, c) do{ \
+    c ^= b; c -= rol32(b, 14); \
+    a ^= c; a -= rol32(c, 11); \
+    b ^= a; b -= rol32(a, 25); \
+    c ^= b; c -= rol32(b, 16); \
+    a ^= c; a -= rol32(c, 4);  \
+    b ^= a; b -= rol32(a, 14); \
+    c ^= b; c -= rol32(b, 24); \
+}while(0)
+
+static inline u32 __jhash_get32(const u8 *k){
+    u32 v;
+
+    memcpy(&v, k, sizeof(v));
+    return v;
+}
+
+static inline u32 jhash(const void *key, u32 length, u32 initval){
+    const u8 *k = key;
+    u32 a, b, c;
+
+    a = b = c = JHASH_INITVAL + length + initval;
+
+    while(length > 12){
+        a += __jhash_get32(k);
+        b += __jhash_get32(k + 4);
+        c += __jhash_get32(k + 8);
+        __jhash_mix(a, b, c);
+        length -= 12;
+        k += 12;
+    }
+
+    switch(length){
+    case 12: c += (u32)k[11] << 24; __attribute__((__fallthrough__));
+    case 11: c += (u32)k[10] << 16; __attribute__((__fallthrough__));
+    case 10: c += (u32)k[9] << 8;   __attribute__((__fallthrough__));
+    case 9:  c += k[8];             __attribute__((__fallthrough__));
+    case 8:  b += (u32)k[7] << 24;  __attribute__((__fallthrough__));
+    case 7:  b += (u32)k[6] << 16;  __attribute__((__fallthrough__));
+    case 6:  b += (u32)k[5] << 8;   __attribute__((__fallthrough__));
+    case 5:  b += k[4];             __attribute__((__fallthrough__));
+    case 4:  a += (u32)k[3] << 24;  __attribute__((__fallthrough__));
+    case 3:  a += (u32)k[2] << 16;  __attribute__((__fallthrough__));
+    case 2:  a += (u32)k[1] << 8;   __attribute__((__fallthrough__));
+    case 1:  a += k[0];
+        __jhash_final(a, b, c);
+        break;
+    case 0:
+        break;
+    }
+
+    return c;
+}
+
+#endif
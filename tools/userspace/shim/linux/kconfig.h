@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+/**
+ * Userspace shim: forced into every unit with -include, as in Kbuild.
+ * No kernel option is enabled.
+ */
+
+#ifndef _SHIM_LINUX_KCONFIG_H
+#define _SHIM_LINUX_KCONFIG_H
+
+#define IS_ENABLED(option) 0
+
+#endif
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#ifndef _SHIM_LINUX_KERNEL_H
+#define _SHIM_LINUX_KERNEL_H
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+
+#include <linux/types.h>
+#include <linux/printk.h>
+
+#define __always_unused __attribute__((__unused__))
+#define __must_check __attribute__((__warn_unused_result__))
+#define fallthrough __attribute__((__fallthrough__))
+#define likely(x) __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+#define container_of(ptr, type, member) \
+    ((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define min_t(type, a, b) min((type)(a), (type)(b))
+#define max_t(type, a, b) max((type)(a), (type)(b))
+#define clamp(val, lo, hi) min(max(val, lo), hi)
+
+#define READ_ONCE(x) (*(const volatile typeof(x) *)&(x))
+#define WRITE_ONCE(x, val) (*(volatile typeof(x) *)&(x) = (val))
+
+//linux/err.h
+#define MAX_ERRNO 4095
+#define IS_ERR_VALUE(x) unlikely((unsigned long)(void *)(x) >= (unsigned long)-MAX_ERRNO)
+
+static inline void *ERR_PTR(long error){
+    return (void *)error;
+}
+
+static inline long PTR_ERR(const void *ptr){
+    return (long)ptr;
+}
+
+static inline bool IS_ERR(const void *ptr){
+    return IS_ERR_VALUE((unsigned long)ptr);
+}
+
+static inline bool IS_ERR_OR_NULL(const void *ptr){
+    return !ptr || IS_ERR(ptr);
+}
+
+//linux/string.h
+static inline ssize_t strscpy(char *dst, const char *src, size_t size){
+    size_t len;
+
+    if(!size)
+        return -E2BIG;
+
+    len = strnlen(src, size);
+    if(len == size){
+        memcpy(dst, src, size - 1);
+        dst[size - 1] = '\0';
+        return -E2BIG;
+    }
+
+    memcpy(dst, src, len + 1);
+    return len;
+}
+
+#endif
@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#ifndef _SHIM_LINUX_KREF_H
+#define _SHIM_LINUX_KREF_H
+
+#include <linux/atomic.h>
+
+struct kref{
+    atomic_t refcount;
+};
+
+static inline void kref_init(struct kref *kref){
+    atomic_set(&kref->refcount, 1);
+}
+
+static inline void kref_get(struct kref *kref){
+    atomic_inc(&kref->refcount);
+}
+
+static inline int kref_put(struct kref *kref, void (*release)(struct kref *kref)){
+    if(atomic_dec_and_test(&kref->refcount)){
+        release(kref);
+        return 1;
+    }
+    return 0;
+}
+
+#endif
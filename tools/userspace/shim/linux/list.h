@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#ifndef _SHIM_LINUX_LIST_H
+#define _SHIM_LINUX_LIST_H
+
+#include <linux/kernel.h>
+
+/**
+ * The subset of the kernel's doubly linked list used by the core, with the
+ * same semantics (no poisoning).
+ */
+
+#define LIST_HEAD_INIT(name) { &(name), &(name) }
+#define LIST_HEAD(name) struct list_head name = LIST_HEAD_INIT(name)
+
+static inline void INIT_LIST_HEAD(struct list_head *list){
+    list->next = list;
+    list->prev = list;
+}
+
+static inline void __list_add(struct list_head *new, struct list_head *prev, struct list_head *next){
+    next->prev = new;
+    new->next = next;
+    new->prev = prev;
+    prev->next = new;
+}
+
+static inline void list_add(struct list_head *new, struct list_head *head){
+    __list_add(new, head, head->next);
+}
+
+static inline void list_add_tail(struct list_head *new, struct list_head *head){
+    __list_add(new, head->prev, head);
+}
+
+static inline void __list_del(struct list_head *prev, struct list_head *next){
+    next->prev = prev;
+    prev->next = next;
+}
+
+static inline void list_del(struct list_head *entry){
+    __list_del(entry->prev, entry->next);
+    entry->next = NULL;
+    entry->prev = NULL;
+}
+
+static inline void list_del_init(struct list_head *entry){
+    __list_del(entry->prev, entry->next);
+    INIT_LIST_HEAD(entry);
+}
+
+static inline int list_empty(const struct list_head *head){
+    return head->next == head;
+}
+
+static inline void list_splice_init(struct list_head *list, struct list_head *head){
+    struct list_head *first = list->next;
+    struct list_head *last = list->prev;
+
+    if(list_empty(list))
+        return;
+
+    first->prev = head;
+    last->next = head->next;
+    head->next->prev = last;
+    head->next = first;
+    INIT_LIST_HEAD(list);
+}
+
+#define list_entry(ptr, type, member) container_of(ptr, type, member)
+#define list_first_entry(ptr, type, member) list_entry((ptr)->next, type, member)
+#define list_next_entry(pos, member) list_entry((pos)->member.next, typeof(*(pos)), member)
+#define list_entry_is_head(pos, head, member) (&(pos)->member == (head))
+
+#define list_for_each_entry(pos, head, member) \
+    for(pos = list_first_entry(head, typeof(*pos), member); \
+        !list_entry_is_head(pos, head, member); \
+        pos = list_next_entry(pos, member))
+
+#define list_for_each_entry_safe(pos, n, head, member) \
+    for(pos = list_first_entry(head, typeof(*pos), member), \
+        n = list_next_entry(pos, member); \
+        !list_entry_is_head(pos, head, member); \
+        pos = n, n = list_next_entry(n, member))
+
+/**
+ * Hash lists, for the buckets of linux/hashtable.h.
+ */
+
+#define HLIST_HEAD_INIT { .first = NULL }
+
+static inline void INIT_HLIST_NODE(struct hlist_node *node){
+    node->next = NULL;
+    node->pprev = NULL;
+}
+
+static inline int hlist_unhashed(const struct hlist_node *node){
+    return !node->pprev;
+}
+
+static inline void hlist_add_head(struct hlist_node *node, struct hlist_head *head){
+    node->next = head->first;
+    if(head->first)
+        head->first->pprev = &node->next;
+    head->first = node;
+    node->pprev = &head->first;
+}
+
+static inline void hlist_del_init(struct hlist_node *node){
+    if(hlist_unhashed(node))
+        return;
+
+    *node->pprev = node->next;
+    if(node->next)
+        node->next->pprev = node->pprev;
+    INIT_HLIST_NODE(node);
+}
+
+#define hlist_entry_safe(ptr, type, member) \
+    ({ typeof(ptr) ____ptr = (ptr); ____ptr ? container_of(____ptr, type, member) : NULL; })
+
+#define hlist_for_each_entry(pos, head, member) \
+    for(pos = hlist_entry_safe((head)->first, typeof(*(pos)), member); \
+        pos; \
+        pos = hlist_entry_safe((pos)->member.next, typeof(*(pos)), member))
+
+#endif
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#ifndef _SHIM_LINUX_MODULE_H
+#define _SHIM_LINUX_MODULE_H
+
+#include <linux/atomic.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/list.h>
+
+/**
+ * Module refcounting as seen by the core: try_module_get() fails once the
+ * module is going away. The harness builds one struct module per simulated
+ * plugin.
+ */
+struct module{
+    char name[64];
+    atomic_t refcnt;
+    bool going;
+};
+
+extern struct module __this_module;
+#define THIS_MODULE (&__this_module)
+
+bool try_module_get(struct module *module);
+void module_put(struct module *module);
+
+#define EXPORT_SYMBOL(sym)
+#define EXPORT_SYMBOL_GPL(sym)
+
+#define MODULE_LICENSE(x)
+#define MODULE_ALIAS(x)
+#define MODULE_AUTHOR(x)
+#define MODULE_DESCRIPTION(x)
+
+//The harness calls the core's init and exit through these
+#define module_init(fn) int shim_module_init(void){ return fn(); }
+#define module_exit(fn) void shim_module_exit(void){ fn(); }
+
+int shim_module_init(void);
+void shim_module_exit(void);
+
+#endif
@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#ifndef _SHIM_LINUX_MUTEX_H
+#define _SHIM_LINUX_MUTEX_H
+
+#include <pthread.h>
+
+#include <linux/types.h>
+
+struct mutex{
+    pthread_mutex_t lock;
+};
+
+#define __MUTEX_INITIALIZER(name) { .lock = PTHREAD_MUTEX_INITIALIZER }
+#define DEFINE_MUTEX(name) struct mutex name = __MUTEX_INITIALIZER(name)
+
+static inline void mutex_init(struct mutex *m){
+    pthread_mutex_init(&m->lock, NULL);
+}
+
+static inline void mutex_destroy(struct mutex *m){
+    pthread_mutex_destroy(&m->lock);
+}
+
+static inline void mutex_lock(struct mutex *m){
+    pthread_mutex_lock(&m->lock);
+}
+
+static inline void mutex_unlock(struct mutex *m){
+    pthread_mutex_unlock(&m->lock);
+}
+
+#endif
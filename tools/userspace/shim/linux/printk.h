@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#ifndef _SHIM_LINUX_PRINTK_H
+#define _SHIM_LINUX_PRINTK_H
+
+/**
+ * Messages at or below shim_loglevel are printed to stderr. The default (3)
+ * only shows errors, so logging does not end up in the measurements.
+ */
+extern int shim_loglevel;
+
+void shim_printk(int level, const char *fmt, ...) __attribute__((__format__(printf, 2, 3)));
+
+#define pr_err(fmt, ...) shim_printk(3, fmt, ##__VA_ARGS__)
+#define pr_warn(fmt, ...) shim_printk(4, fmt, ##__VA_ARGS__)
+#define pr_info(fmt, ...) shim_printk(6, fmt, ##__VA_ARGS__)
+#define pr_debug(fmt, ...) shim_printk(7, fmt, ##__VA_ARGS__)
+
+#endif
@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#ifndef _SHIM_LINUX_SEQ_FILE_H
+#define _SHIM_LINUX_SEQ_FILE_H
+
+#include <linux/kernel.h>
+
+/**
+ * Output only: a fixed buffer, "count == size" once it overflowed.
+ */
+struct seq_file{
+    char *buf;
+    size_t size;
+    size_t count;
+    void *private;
+};
+
+void seq_printf(struct seq_file *m, const char *fmt, ...) __attribute__((__format__(printf, 2, 3)));
+void seq_write(struct seq_file *m, const void *data, size_t len);
+
+static inline bool seq_has_overflowed(struct seq_file *m){
+    return m->count == m->size;
+}
+
+#endif
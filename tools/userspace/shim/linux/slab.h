@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+#ifndef _SHIM_LINUX_SLAB_H
+#define _SHIM_LINUX_SLAB_H
+
+#include <stdlib.h>
+
+#include <linux/cache.h>
+#include <linux/kernel.h>
+
+/**
+ * Allocations are cache-line aligned, like kmalloc() of the sizes the core
+ * uses. GFP and SLAB flags are ignored.
+ */
+#define GFP_KERNEL 0U
+#define GFP_KERNEL_ACCOUNT 0U
+#define GFP_ATOMIC 0U
+#define SLAB_ACCOUNT 0UL
+
+void *kmalloc(size_t size, gfp_t flags);
+void *kzalloc(size_t size, gfp_t flags);
+void *kcalloc(size_t n, size_t size, gfp_t flags);
+void kfree(const void *ptr);
+
+struct kmem_cache{
+    const char *name;
+    size_t size;
+};
+
+struct kmem_cache *kmem_cache_create(const char *name, size_t size, size_t align,
+    unsigned long flags, void (*ctor)(void *));
+void kmem_cache_destroy(struct kmem_cache *cache);
+void *kmem_cache_zalloc(struct kmem_cache *cache, gfp_t flags);
+void kmem_cache_free(struct kmem_cache *cache, void *obj);
+
+#define KMEM_CACHE(__struct, __flags) \
+    kmem_cache_create(#__struct, sizeof(struct __struct), __alignof__(struct __struct), (__flags), NULL)
+
+#endif
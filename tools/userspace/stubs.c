@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-2.0
+/**
+ * LKM: userspace harness, stand-ins for the rest of sfgcore
+ *
+ * Copyright (C) 2026 Saúl Fernández García <https://github.com/saulfernandezgarcia>
+ */
+
+/**
+ * Only the registry (core.c) is built in the harness. Subsystems it calls
+ * into are reduced to what keeps its behaviour: memory accounting is kept,
+ * debugfs, kthreads, triggers and the chardev do nothing.
+ */
+
+#include <linux/atomic.h>
+
+#include "harness.h"
+
+size_t core_output_budget = 1 << 20;
+
+static atomic_long_t mem_bytes[CORE_MEM_MAX];
+
+void core_mem_add(enum core_mem_kind kind, long bytes){
+    atomic_long_add(bytes, &mem_bytes[kind]);
+}
+
+long stub_mem_bytes(enum core_mem_kind kind){
+    return atomic_long_read(&mem_bytes[kind]);
+}
+
+//No retained runs without core_run.c
+void core_check_state_flush(struct core_check_state *state){
+}
+
+struct dentry *core_debugfs_add_check(struct lkm_check *check){
+    return NULL;
+}
+
+void core_debugfs_remove_check(struct dentry *file){
+}
+
+int core_debugfs_init(void){
+    return 0;
+}
+
+void core_debugfs_exit(void){
+}
+
+int core_exec_init(void){
+    return 0;
+}
+
+void core_exec_exit(void){
+}
+
+int core_trigger_init(void){
+    return 0;
+}
+
+void core_trigger_exit(void){
+}
+
+int core_chrdev_init(void){
+    return 0;
+}
+
+void core_chrdev_exit(void){
+}
+
+void core_boot_check_registered(struct lkm_check *check){
+}
+
+void core_boot_exit(void){
+}
+
+void core_scope_exit(void){
+}